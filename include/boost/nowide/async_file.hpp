@@ -0,0 +1,815 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef BOOST_NOWIDE_ASYNC_FILE_HPP_INCLUDED
+#define BOOST_NOWIDE_ASYNC_FILE_HPP_INCLUDED
+
+#include <boost/nowide/config.hpp>
+/// \cond INTERNAL
+#if !defined(BOOST_NO_CXX11_HDR_THREAD) && !defined(BOOST_NO_CXX11_HDR_MUTEX) \
+  && !defined(BOOST_NO_CXX11_HDR_CONDITION_VARIABLE) && !defined(BOOST_NO_CXX11_HDR_FUNCTIONAL) \
+  && !defined(BOOST_NO_CXX11_SMART_PTR)
+#define BOOST_NOWIDE_HAS_ASYNC_FILE 1
+#else
+#define BOOST_NOWIDE_HAS_ASYNC_FILE 0
+#endif
+/// \endcond
+
+#if BOOST_NOWIDE_HAS_ASYNC_FILE
+#include <boost/nowide/stackstring.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <ios>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifndef BOOST_WINDOWS
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef BOOST_NOWIDE_USE_FILESYSTEM
+#include <boost/filesystem/path.hpp>
+#endif
+
+/// \cond INTERNAL
+#if defined(__linux__) && !defined(BOOST_NOWIDE_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
+#if defined(IORING_OFF_SQ_RING) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define BOOST_NOWIDE_ASYNC_FILE_HAS_IO_URING 1
+#else
+#define BOOST_NOWIDE_ASYNC_FILE_HAS_IO_URING 0
+#endif
+/// \endcond
+
+#ifdef BOOST_MSVC
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif
+
+namespace boost {
+namespace nowide {
+
+    ///
+    /// \brief Called with the result of an asynchronous operation: The number of bytes transferred, 0 for a
+    /// successful fsync, or a negative system error code (-errno on POSIX, -GetLastError() on Windows)
+    ///
+    typedef std::function<void(std::ptrdiff_t)> async_callback;
+
+    ///
+    /// \brief A file opened by UTF-8 name for positional and asynchronous I/O
+    ///
+    /// Asynchronous operations are submitted through an async_batch to an async_file_service.
+    /// The file must stay open until all of its operations have completed.
+    ///
+    class BOOST_NOWIDE_DECL async_file
+    {
+        // Non-copyable
+        async_file(const async_file &);
+        async_file &operator=(const async_file &);
+
+    public:
+#ifdef BOOST_WINDOWS
+        typedef void *native_handle_type;
+#else
+        typedef int native_handle_type;
+#endif
+
+        async_file();
+        ///
+        /// Open the file with the UTF-8 name, see open()
+        ///
+        explicit async_file(char const *name, std::ios_base::openmode mode = std::ios_base::in);
+        ~async_file();
+
+        ///
+        /// Open the file with the UTF-8 name. Supported modes are in, out (which truncates), in|out and in|out|trunc,
+        /// binary is implied. append is not supported as all I/O is done at explicit offsets
+        ///
+        bool open(char const *name, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            wstackstring const name2(name);
+            return open(name2.c_str(), mode);
+        }
+        bool open(std::string const &name, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            return open(name.c_str(), mode);
+        }
+        bool open(wchar_t const *name, std::ios_base::openmode mode = std::ios_base::in);
+#ifdef BOOST_NOWIDE_USE_FILESYSTEM
+        bool open(boost::filesystem::path const &name, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            return open(name.c_str(), mode);
+        }
+#endif
+        bool is_open() const;
+        bool close();
+        ///
+        /// Current size of the file or -1 on error
+        ///
+        std::streamoff size() const;
+        native_handle_type native_handle() const
+        {
+            return handle_;
+        }
+
+        ///
+        /// Read up to n bytes at offset synchronously, like pread. Returns the number of bytes read or a negative error
+        ///
+        std::ptrdiff_t read_at(std::streamoff offset, char *data, size_t n);
+        ///
+        /// Write up to n bytes at offset synchronously, like pwrite. Returns the number of bytes written or a negative
+        /// error
+        ///
+        std::ptrdiff_t write_at(std::streamoff offset, char const *data, size_t n);
+        ///
+        /// Flush the data of the file to the storage device. Returns 0 or a negative error
+        ///
+        std::ptrdiff_t sync();
+
+    private:
+        /// Check the mode and strip binary and ate
+        static bool get_mode(std::ios_base::openmode &mode)
+        {
+            unsigned const ignored = static_cast<unsigned>(std::ios_base::binary | std::ios_base::ate);
+            mode = static_cast<std::ios_base::openmode>(static_cast<unsigned>(mode) & ~ignored);
+            return mode == std::ios_base::in || mode == std::ios_base::out
+                   || mode == (std::ios_base::out | std::ios_base::trunc)
+                   || mode == (std::ios_base::in | std::ios_base::out)
+                   || mode == (std::ios_base::in | std::ios_base::out | std::ios_base::trunc);
+        }
+
+        native_handle_type handle_;
+    };
+
+    /// \cond INTERNAL
+    namespace details {
+        enum async_op
+        {
+            async_read,
+            async_write,
+            async_fsync
+        };
+        struct async_request
+        {
+            async_op op;
+            async_file *file;
+            std::streamoff offset;
+            char *data;
+            size_t size;
+            async_callback callback;
+            std::ptrdiff_t result;
+#if BOOST_NOWIDE_ASYNC_FILE_HAS_IO_URING
+            /// Buffer description for IORING_OP_READV/WRITEV, supported since the first io_uring kernels
+            iovec iov;
+#endif
+
+            /// Do the operation synchronously
+            void execute()
+            {
+                switch(op)
+                {
+                case async_read: result = file->read_at(offset, data, size); break;
+                case async_write: result = file->write_at(offset, data, size); break;
+                case async_fsync: result = file->sync(); break;
+                }
+            }
+        };
+
+        ///
+        /// \brief Executes requests in the background
+        ///
+        class async_queue
+        {
+        public:
+            virtual ~async_queue()
+            {}
+            /// Start the requests, ownership is passed to the queue until they are returned by wait()
+            virtual void submit(std::vector<async_request *> &requests) = 0;
+            /// Append the completed requests to done. If block is true, wait until at least one is completed unless
+            /// nothing is outstanding
+            virtual void wait(std::deque<async_request *> &done, bool block) = 0;
+            /// Number of submitted requests not yet returned by wait()
+            virtual size_t outstanding() const = 0;
+        };
+
+        ///
+        /// \brief Queue executing the requests synchronously in a pool of threads
+        ///
+        class thread_pool_queue : public async_queue
+        {
+        public:
+            explicit thread_pool_queue(unsigned threads) : outstanding_(0), stop_(false)
+            {
+                for(unsigned i = 0; i < threads; i++)
+                    threads_.push_back(std::thread(&thread_pool_queue::run, this));
+            }
+            /// Executes the remaining requests, discarding them
+            ~thread_pool_queue()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stop_ = true;
+                }
+                work_cv_.notify_all();
+                for(size_t i = 0; i < threads_.size(); i++)
+                    threads_[i].join();
+                for(size_t i = 0; i < done_.size(); i++)
+                    delete done_[i];
+            }
+            virtual void submit(std::vector<async_request *> &requests)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    queued_.insert(queued_.end(), requests.begin(), requests.end());
+                    outstanding_ += requests.size();
+                }
+                requests.clear();
+                work_cv_.notify_all();
+            }
+            virtual void wait(std::deque<async_request *> &done, bool block)
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while(block && done_.empty() && outstanding_)
+                    done_cv_.wait(lock);
+                done.insert(done.end(), done_.begin(), done_.end());
+                outstanding_ -= done_.size();
+                done_.clear();
+            }
+            virtual size_t outstanding() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return outstanding_;
+            }
+
+        private:
+            void run()
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                for(;;)
+                {
+                    while(queued_.empty() && !stop_)
+                        work_cv_.wait(lock);
+                    if(queued_.empty())
+                        return;
+                    async_request *const r = queued_.front();
+                    queued_.pop_front();
+                    lock.unlock();
+                    r->execute();
+                    lock.lock();
+                    done_.push_back(r);
+                    done_cv_.notify_all();
+                }
+            }
+
+            mutable std::mutex mutex_;
+            std::condition_variable work_cv_;
+            std::condition_variable done_cv_;
+            std::vector<std::thread> threads_;
+            std::deque<async_request *> queued_;
+            std::vector<async_request *> done_;
+            size_t outstanding_;
+            bool stop_;
+        };
+
+#if BOOST_NOWIDE_ASYNC_FILE_HAS_IO_URING
+        ///
+        /// \brief Queue submitting the requests to an io_uring of the Linux kernel, using the raw system calls
+        ///
+        /// At most as many requests as the submission queue has entries are in flight, so the completion queue
+        /// (twice as large) can't overflow. The others wait in a queue of their own.
+        ///
+        class io_uring_queue : public async_queue
+        {
+            // Non-copyable
+            io_uring_queue(const io_uring_queue &);
+            io_uring_queue &operator=(const io_uring_queue &);
+
+        public:
+            io_uring_queue() :
+                fd_(-1), sq_ptr_(MAP_FAILED), cq_ptr_(MAP_FAILED), sqes_ptr_(MAP_FAILED), sq_size_(0), cq_size_(0),
+                sqes_size_(0), entries_(0), in_flight_(0), unsubmitted_(0)
+            {}
+            /// Waits for the requests in flight, discarding them
+            ~io_uring_queue()
+            {
+                if(fd_ != -1)
+                {
+                    std::deque<async_request *> done;
+                    while(outstanding())
+                    {
+                        wait(done, true);
+                        for(size_t i = 0; i < done.size(); i++)
+                            delete done[i];
+                        done.clear();
+                    }
+                }
+                if(sqes_ptr_ != MAP_FAILED)
+                    ::munmap(sqes_ptr_, sqes_size_);
+                if(cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+                    ::munmap(cq_ptr_, cq_size_);
+                if(sq_ptr_ != MAP_FAILED)
+                    ::munmap(sq_ptr_, sq_size_);
+                if(fd_ != -1)
+                    ::close(fd_);
+            }
+            /// Create the ring, returns false if io_uring is not available (old kernel, disabled, ...)
+            bool init(unsigned entries)
+            {
+                io_uring_params params;
+                std::memset(&params, 0, sizeof(params));
+                fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+                if(fd_ < 0)
+                {
+                    fd_ = -1;
+                    return false;
+                }
+                sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+                bool single_mmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+                single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if(single_mmap)
+                    sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+#endif
+                sq_ptr_ = map(sq_size_, IORING_OFF_SQ_RING);
+                cq_ptr_ = single_mmap ? sq_ptr_ : map(cq_size_, IORING_OFF_CQ_RING);
+                sqes_ptr_ = map(sqes_size_, IORING_OFF_SQES);
+                if(sq_ptr_ == MAP_FAILED || cq_ptr_ == MAP_FAILED || sqes_ptr_ == MAP_FAILED)
+                    return false;
+                char *const sq = static_cast<char *>(sq_ptr_);
+                sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+                sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+                sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+                char *const cq = static_cast<char *>(cq_ptr_);
+                cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+                cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+                cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+                cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+                sqes_ = static_cast<io_uring_sqe *>(sqes_ptr_);
+                entries_ = params.sq_entries;
+                return true;
+            }
+            virtual void submit(std::vector<async_request *> &requests)
+            {
+                queued_.insert(queued_.end(), requests.begin(), requests.end());
+                requests.clear();
+                fill();
+                enter(0);
+            }
+            virtual void wait(std::deque<async_request *> &done, bool block)
+            {
+                if(block && in_flight_ && !completions_available())
+                    enter(1);
+                else if(unsubmitted_)
+                    enter(0);
+                reap(done);
+                // Slots became free
+                if(!queued_.empty())
+                {
+                    fill();
+                    enter(0);
+                }
+            }
+            virtual size_t outstanding() const
+            {
+                return in_flight_ + queued_.size() + failed_.size();
+            }
+
+        private:
+            void *map(size_t size, long long offset)
+            {
+                return ::mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, static_cast<off_t>(offset));
+            }
+            /// Move queued requests into free slots of the submission queue
+            void fill()
+            {
+                // Only this thread writes the tail
+                unsigned tail = *sq_tail_;
+                while(!queued_.empty() && in_flight_ < entries_)
+                {
+                    async_request *const r = queued_.front();
+                    queued_.pop_front();
+                    unsigned const index = tail & sq_mask_;
+                    io_uring_sqe &sqe = sqes_[index];
+                    std::memset(&sqe, 0, sizeof(sqe));
+                    sqe.fd = r->file->native_handle();
+                    sqe.user_data = reinterpret_cast<unsigned long long>(r);
+                    if(r->op == async_fsync)
+                        sqe.opcode = IORING_OP_FSYNC;
+                    else
+                    {
+                        sqe.opcode = r->op == async_read ? IORING_OP_READV : IORING_OP_WRITEV;
+                        r->iov.iov_base = r->data;
+                        r->iov.iov_len = r->size;
+                        sqe.addr = reinterpret_cast<unsigned long long>(&r->iov);
+                        sqe.len = 1;
+                        sqe.off = static_cast<unsigned long long>(r->offset);
+                    }
+                    sq_array_[index] = index;
+                    tail++;
+                    in_flight_++;
+                    unsubmitted_++;
+                }
+                // Make the entries visible before the new tail
+                __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+            }
+            /// Submit the new entries and wait for min_complete completions
+            void enter(unsigned min_complete)
+            {
+                if(!unsubmitted_ && !min_complete)
+                    return;
+                unsigned const flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+                for(;;)
+                {
+                    long const res = ::syscall(__NR_io_uring_enter, fd_, unsubmitted_, min_complete, flags, 0, 0);
+                    if(res >= 0)
+                    {
+                        unsubmitted_ -= static_cast<unsigned>(res);
+                        return;
+                    }
+                    int const error = errno;
+                    if(error == EINTR)
+                        continue;
+                    if(error == EAGAIN || error == EBUSY)
+                    {
+                        // Out of resources, the entries are submitted with the next call after some completed
+                        if(min_complete || !in_flight_)
+                            std::this_thread::yield();
+                        return;
+                    }
+                    fail_unsubmitted(error);
+                    return;
+                }
+            }
+            /// Take back the entries the kernel did not consume and complete them with -error
+            void fail_unsubmitted(int error)
+            {
+                unsigned tail = *sq_tail_;
+                for(; unsubmitted_; unsubmitted_--)
+                {
+                    tail--;
+                    io_uring_sqe const &sqe = sqes_[sq_array_[tail & sq_mask_]];
+                    async_request *const r = reinterpret_cast<async_request *>(sqe.user_data);
+                    r->result = -error;
+                    failed_.push_front(r);
+                    in_flight_--;
+                }
+                __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+            }
+            bool completions_available() const
+            {
+                return *cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            }
+            void reap(std::deque<async_request *> &done)
+            {
+                done.insert(done.end(), failed_.begin(), failed_.end());
+                failed_.clear();
+                // Only this thread writes the head
+                unsigned head = *cq_head_;
+                unsigned const tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+                for(; head != tail; head++)
+                {
+                    io_uring_cqe const &cqe = cqes_[head & cq_mask_];
+                    async_request *const r = reinterpret_cast<async_request *>(cqe.user_data);
+                    r->result = cqe.res;
+                    done.push_back(r);
+                    in_flight_--;
+                }
+                __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            }
+
+            int fd_;
+            void *sq_ptr_;
+            void *cq_ptr_;
+            void *sqes_ptr_;
+            size_t sq_size_;
+            size_t cq_size_;
+            size_t sqes_size_;
+            unsigned *sq_tail_;
+            unsigned sq_mask_;
+            unsigned *sq_array_;
+            unsigned *cq_head_;
+            unsigned *cq_tail_;
+            unsigned cq_mask_;
+            io_uring_cqe *cqes_;
+            io_uring_sqe *sqes_;
+            unsigned entries_;
+            unsigned in_flight_;
+            unsigned unsubmitted_;
+            std::deque<async_request *> queued_;
+            std::deque<async_request *> failed_;
+        };
+#endif
+    } // namespace details
+    /// \endcond
+
+    ///
+    /// \brief A set of asynchronous operations submitted together to an async_file_service
+    ///
+    /// Data buffers must stay valid until the callback of their operation was called.
+    ///
+    class async_batch
+    {
+        // Non-copyable
+        async_batch(const async_batch &);
+        async_batch &operator=(const async_batch &);
+
+    public:
+        async_batch()
+        {}
+        ~async_batch()
+        {
+            clear();
+        }
+        ///
+        /// Read up to n bytes at offset into data
+        ///
+        void read(async_file &file, std::streamoff offset, char *data, size_t n, async_callback callback = async_callback())
+        {
+            add(details::async_read, file, offset, data, n, callback);
+        }
+        ///
+        /// Write up to n bytes of data at offset
+        ///
+        void write(async_file &file, std::streamoff offset, char const *data, size_t n,
+                   async_callback callback = async_callback())
+        {
+            add(details::async_write, file, offset, const_cast<char *>(data), n, callback);
+        }
+        ///
+        /// Flush the file to the storage device. Not ordered with respect to other operations in flight, so submit it
+        /// after their completion to make their data durable
+        ///
+        void fsync(async_file &file, async_callback callback = async_callback())
+        {
+            add(details::async_fsync, file, 0, 0, 0, callback);
+        }
+        ///
+        /// Number of operations in the batch
+        ///
+        size_t size() const
+        {
+            return requests_.size();
+        }
+        bool empty() const
+        {
+            return requests_.empty();
+        }
+        ///
+        /// Remove all operations
+        ///
+        void clear()
+        {
+            for(size_t i = 0; i < requests_.size(); i++)
+                delete requests_[i];
+            requests_.clear();
+        }
+
+    private:
+        friend class async_file_service;
+        void add(details::async_op op, async_file &file, std::streamoff offset, char *data, size_t n,
+                 async_callback const &callback)
+        {
+            std::unique_ptr<details::async_request> r(new details::async_request());
+            r->op = op;
+            r->file = &file;
+            r->offset = offset;
+            r->data = data;
+            r->size = n;
+            r->callback = callback;
+            r->result = 0;
+            requests_.reserve(requests_.size() + 1);
+            requests_.push_back(r.release());
+        }
+
+        std::vector<details::async_request *> requests_;
+    };
+
+    ///
+    /// \brief Executes asynchronous file operations submitted in batches
+    ///
+    /// Uses an io_uring on Linux when available, so a whole batch is submitted with a single system call and
+    /// executed by the kernel without blocking any thread. Otherwise the operations are executed by a pool of threads.
+    ///
+    /// Callbacks are called by poll() and run() in the calling thread and may submit further batches.
+    /// The service is meant to be used by a single thread.
+    ///
+    class async_file_service
+    {
+        // Non-copyable
+        async_file_service(const async_file_service &);
+        async_file_service &operator=(const async_file_service &);
+
+    public:
+        ///
+        /// Create a service executing up to queue_depth operations at the same time.
+        /// If use_io_uring is false or io_uring is not available, a pool of up to queue_depth threads is used
+        ///
+        explicit async_file_service(unsigned queue_depth = 64, bool use_io_uring = true) : io_uring_(false)
+        {
+            queue_depth = std::max(queue_depth, 1u);
+#if BOOST_NOWIDE_ASYNC_FILE_HAS_IO_URING
+            if(use_io_uring)
+            {
+                std::unique_ptr<details::io_uring_queue> ring(new details::io_uring_queue());
+                if(ring->init(queue_depth))
+                {
+                    queue_.reset(ring.release());
+                    io_uring_ = true;
+                }
+            }
+#else
+            (void)use_io_uring;
+#endif
+            if(!queue_)
+            {
+                // Threads mostly wait for I/O, so more than cores are useful, but not unboundedly many
+                unsigned const max_threads = std::max(std::thread::hardware_concurrency(), 1u) * 4;
+                queue_.reset(new details::thread_pool_queue(std::min(queue_depth, max_threads)));
+            }
+        }
+        ///
+        /// Wait for all submitted operations to finish without calling their callbacks
+        ///
+        ~async_file_service()
+        {
+            queue_.reset();
+            for(size_t i = 0; i < completed_.size(); i++)
+                delete completed_[i];
+        }
+
+        ///
+        /// True if the operations are executed by an io_uring, false if by a thread pool
+        ///
+        bool uses_io_uring() const
+        {
+            return io_uring_;
+        }
+        ///
+        /// Start all operations of the batch, which is empty afterwards
+        ///
+        void submit(async_batch &batch)
+        {
+            queue_->submit(batch.requests_);
+        }
+        ///
+        /// Call the callbacks of all completed operations without waiting. Returns the number of operations completed
+        ///
+        size_t poll()
+        {
+            return complete(false);
+        }
+        ///
+        /// Wait for all submitted operations, including those submitted by callbacks, and call their callbacks.
+        /// Returns the number of operations completed
+        ///
+        size_t run()
+        {
+            size_t n = complete(false);
+            while(pending())
+                n += complete(true);
+            return n;
+        }
+        ///
+        /// Number of submitted operations whose callbacks have not been called yet
+        ///
+        size_t pending() const
+        {
+            return queue_->outstanding() + completed_.size();
+        }
+
+    private:
+        size_t complete(bool block)
+        {
+            queue_->wait(completed_, block);
+            size_t n = 0;
+            // Requests stay queued if a callback throws
+            while(!completed_.empty())
+            {
+                std::unique_ptr<details::async_request> r(completed_.front());
+                completed_.pop_front();
+                n++;
+                if(r->callback)
+                    r->callback(r->result);
+            }
+            return n;
+        }
+
+        std::unique_ptr<details::async_queue> queue_;
+        std::deque<details::async_request *> completed_;
+        bool io_uring_;
+    };
+
+#ifndef BOOST_WINDOWS
+    inline async_file::async_file() : handle_(-1)
+    {}
+    inline async_file::async_file(char const *name, std::ios_base::openmode mode) : handle_(-1)
+    {
+        open(name, mode);
+    }
+    inline async_file::~async_file()
+    {
+        close();
+    }
+    inline bool async_file::open(wchar_t const *name, std::ios_base::openmode mode)
+    {
+        if(is_open() || !get_mode(mode))
+            return false;
+        int flags;
+        if(mode == std::ios_base::in)
+            flags = O_RDONLY;
+        else if(mode == (std::ios_base::in | std::ios_base::out))
+            flags = O_RDWR;
+        else if(mode & std::ios_base::in)
+            flags = O_RDWR | O_CREAT | O_TRUNC;
+        else
+            flags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_CLOEXEC
+        flags |= O_CLOEXEC;
+#endif
+        stackstring const name2(name);
+        do
+        {
+            handle_ = ::open(name2.c_str(), flags, 0666);
+        } while(handle_ == -1 && errno == EINTR);
+        return handle_ != -1;
+    }
+    inline bool async_file::is_open() const
+    {
+        return handle_ != -1;
+    }
+    inline bool async_file::close()
+    {
+        if(handle_ == -1)
+            return true;
+        // Don't retry on EINTR, the descriptor is released anyway
+        bool const res = ::close(handle_) == 0;
+        handle_ = -1;
+        return res;
+    }
+    inline std::streamoff async_file::size() const
+    {
+        struct stat st;
+        if(::fstat(handle_, &st) != 0)
+            return -1;
+        return st.st_size;
+    }
+    inline std::ptrdiff_t async_file::read_at(std::streamoff offset, char *data, size_t n)
+    {
+        if(static_cast<std::streamoff>(static_cast<off_t>(offset)) != offset)
+            return -EOVERFLOW;
+        ssize_t res;
+        do
+        {
+            res = ::pread(handle_, data, n, static_cast<off_t>(offset));
+        } while(res < 0 && errno == EINTR);
+        return res < 0 ? -errno : res;
+    }
+    inline std::ptrdiff_t async_file::write_at(std::streamoff offset, char const *data, size_t n)
+    {
+        if(static_cast<std::streamoff>(static_cast<off_t>(offset)) != offset)
+            return -EOVERFLOW;
+        ssize_t res;
+        do
+        {
+            res = ::pwrite(handle_, data, n, static_cast<off_t>(offset));
+        } while(res < 0 && errno == EINTR);
+        return res < 0 ? -errno : res;
+    }
+    inline std::ptrdiff_t async_file::sync()
+    {
+        return ::fsync(handle_) == 0 ? 0 : -errno;
+    }
+#endif
+
+} // namespace nowide
+} // namespace boost
+
+#ifdef BOOST_MSVC
+#pragma warning(pop)
+#endif
+
+#endif // BOOST_NOWIDE_HAS_ASYNC_FILE
+
+#endif
+
+// vim: tabstop=4 expandtab shiftwidth=4 softtabstop=4
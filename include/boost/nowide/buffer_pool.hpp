@@ -0,0 +1,421 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef BOOST_NOWIDE_BUFFER_POOL_HPP_INCLUDED
+#define BOOST_NOWIDE_BUFFER_POOL_HPP_INCLUDED
+
+#include <boost/nowide/config.hpp>
+#include <boost/cstdint.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#ifdef BOOST_WINDOWS
+#include <malloc.h>
+#endif
+/// \cond INTERNAL
+#if !defined(BOOST_NO_CXX11_HDR_ATOMIC) && !defined(BOOST_NO_CXX11_HDR_MUTEX) && !defined(BOOST_NO_CXX11_THREAD_LOCAL)
+#define BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE 1
+#include <atomic>
+#include <mutex>
+#include <vector>
+#else
+#define BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE 0
+#endif
+/// \endcond
+
+namespace boost {
+namespace nowide {
+
+    ///
+    /// \brief Source of the I/O buffers used by basic_filebuf
+    ///
+    /// Implementations must be thread-safe if filebufs using them are used from multiple threads.
+    ///
+    class buffer_provider
+    {
+    public:
+        virtual ~buffer_provider()
+        {}
+        ///
+        /// Return a buffer of at least n bytes. Throws std::bad_alloc on failure
+        ///
+        virtual char *allocate(size_t n) = 0;
+        ///
+        /// Give back a buffer returned by allocate(n)
+        ///
+        virtual void deallocate(char *p, size_t n) = 0;
+    };
+
+    /// \cond INTERNAL
+    namespace details {
+        inline char *aligned_alloc(size_t n, size_t alignment)
+        {
+#ifdef BOOST_WINDOWS
+            void *p = _aligned_malloc(n, alignment);
+#else
+            void *p;
+            if(posix_memalign(&p, alignment, n) != 0)
+                p = 0;
+#endif
+            if(!p)
+                throw std::bad_alloc();
+            return static_cast<char *>(p);
+        }
+        inline void aligned_free(char *p)
+        {
+#ifdef BOOST_WINDOWS
+            _aligned_free(p);
+#else
+            std::free(p);
+#endif
+        }
+    } // namespace details
+    /// \endcond
+
+    ///
+    /// \brief Provider allocating every buffer from the heap and freeing it on return
+    ///
+    /// Buffers are aligned to #alignment bytes, so they can be used for unbuffered I/O.
+    ///
+    class heap_buffer_provider : public buffer_provider
+    {
+    public:
+        /// Alignment of all buffers, suitable for unbuffered I/O
+        static const size_t alignment = 4096;
+
+        virtual char *allocate(size_t n)
+        {
+            return details::aligned_alloc(n, alignment);
+        }
+        virtual void deallocate(char *p, size_t /*n*/)
+        {
+            details::aligned_free(p);
+        }
+    };
+
+    ///
+    /// \brief Pool of buffers in power of two size classes
+    ///
+    /// The size classes are buffer_size(), twice that and so on up to max_buffer_size(). Requests are rounded up to
+    /// the next class, so buffers of sizes changed at runtime or by adaptive buffering are pooled too. Larger requests
+    /// go to the heap. All buffers are aligned to #alignment bytes.
+    ///
+    /// Returned buffers are kept in a few per-thread slots and a fixed number of shared slots per class and handed out
+    /// again instead of allocating new ones. Returns to a full class go to the heap. Larger classes have fewer shared
+    /// slots, so each class keeps at most about capacity * buffer_size() bytes.
+    ///
+    /// allocate() and deallocate() are lock-free, construction, destruction and thread exit take a mutex.
+    /// The per-thread slots give buffers back to their pool when the thread exits, or free them if the pool was
+    /// destroyed meanwhile. Without C++11 atomics, mutexes and thread_local every buffer is allocated from the heap.
+    ///
+    class buffer_pool : public buffer_provider
+    {
+        // Non-copyable
+        buffer_pool(buffer_pool const &);
+        buffer_pool &operator=(buffer_pool const &);
+
+    public:
+        /// Alignment of all buffers, suitable for unbuffered I/O
+        static const size_t alignment = 4096;
+
+        ///
+        /// Create a pool of size_classes classes starting at buffer_size bytes. The smallest class keeps up to
+        /// capacity unused buffers in the shared slots, each larger class half as many but at least one
+        ///
+        explicit buffer_pool(size_t buffer_size = BOOST_NOWIDE_FILEBUF_BUFFER_SIZE, size_t capacity = 64,
+                             size_t size_classes = 1) :
+            buffer_size_(std::max<size_t>(buffer_size, 1)),
+            size_classes_(std::max<size_t>(size_classes, 1))
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+            ,
+            id_(0), capacity_(capacity), slots_(0), hits_(0), misses_(0)
+#endif
+        {
+            // The largest class must be representable
+            while(size_classes_ > 1 && (buffer_size_ << (size_classes_ - 1)) >> (size_classes_ - 1) != buffer_size_)
+                size_classes_--;
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+            size_t const num_slots = slots_begin(size_classes_);
+            slots_ = new std::atomic<char *>[num_slots];
+            for(size_t i = 0; i < num_slots; i++)
+                slots_[i].store(0, std::memory_order_relaxed);
+            registry &reg = get_registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            id_ = ++reg.last_id;
+            reg.pools.push_back(this);
+#else
+            (void)capacity;
+#endif
+        }
+        ///
+        /// Free all unused buffers. Buffers still in use must not be given back afterwards
+        ///
+        virtual ~buffer_pool()
+        {
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+            {
+                // Afterwards exiting threads free the buffers they still hold instead of giving them back
+                registry &reg = get_registry();
+                std::lock_guard<std::mutex> lock(reg.mutex);
+                reg.pools.erase(std::find(reg.pools.begin(), reg.pools.end(), this));
+            }
+            thread_cache &cache = get_thread_cache();
+            for(size_t i = 0; i < thread_cache::size; i++)
+            {
+                if(cache.pools[i] == id_)
+                {
+                    details::aligned_free(cache.buffers[i]);
+                    cache.pools[i] = 0;
+                }
+            }
+            for(size_t i = 0; i < slots_begin(size_classes_); i++)
+            {
+                if(char *p = slots_[i].load(std::memory_order_relaxed))
+                    details::aligned_free(p);
+            }
+            delete[] slots_;
+#endif
+        }
+
+        ///
+        /// The process-wide pool used by default by all filebufs. It is never destroyed.
+        ///
+        /// Its classes range from BOOST_NOWIDE_FILEBUF_BUFFER_SIZE to 128 times that (1 MiB by default), so buffers
+        /// of all sizes up to that are pooled
+        ///
+        static buffer_pool &global()
+        {
+            static buffer_pool *pool = new buffer_pool(BOOST_NOWIDE_FILEBUF_BUFFER_SIZE, 64, 8);
+            return *pool;
+        }
+
+        ///
+        /// Size of the buffers of the smallest class
+        ///
+        size_t buffer_size() const
+        {
+            return buffer_size_;
+        }
+        ///
+        /// Size of the buffers of the largest class, larger requests are not pooled
+        ///
+        size_t max_buffer_size() const
+        {
+            return buffer_size_ << (size_classes_ - 1);
+        }
+        ///
+        /// Number of size classes
+        ///
+        size_t size_classes() const
+        {
+            return size_classes_;
+        }
+        ///
+        /// Number of buffers handed out from the pool
+        ///
+        size_t hits() const
+        {
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+            return hits_.load(std::memory_order_relaxed);
+#else
+            return 0;
+#endif
+        }
+        ///
+        /// Number of buffers which had to be allocated
+        ///
+        size_t misses() const
+        {
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+            return misses_.load(std::memory_order_relaxed);
+#else
+            return 0;
+#endif
+        }
+
+        virtual char *allocate(size_t n)
+        {
+            size_t const size_class = get_size_class(n);
+            if(size_class == size_classes_)
+            {
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+                misses_.fetch_add(1, std::memory_order_relaxed);
+#endif
+                return details::aligned_alloc(n, alignment);
+            }
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+            thread_cache &cache = get_thread_cache();
+            for(size_t i = 0; i < thread_cache::size; i++)
+            {
+                if(cache.pools[i] == id_ && cache.size_classes[i] == size_class)
+                {
+                    cache.pools[i] = 0;
+                    hits_.fetch_add(1, std::memory_order_relaxed);
+                    return cache.buffers[i];
+                }
+            }
+            for(size_t i = slots_begin(size_class); i < slots_begin(size_class + 1); i++)
+            {
+                if(slots_[i].load(std::memory_order_relaxed))
+                {
+                    if(char *p = slots_[i].exchange(0, std::memory_order_acquire))
+                    {
+                        hits_.fetch_add(1, std::memory_order_relaxed);
+                        return p;
+                    }
+                }
+            }
+            misses_.fetch_add(1, std::memory_order_relaxed);
+#endif
+            return details::aligned_alloc(buffer_size_ << size_class, alignment);
+        }
+
+        virtual void deallocate(char *p, size_t n)
+        {
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+            size_t const size_class = get_size_class(n);
+            if(size_class != size_classes_)
+            {
+                thread_cache &cache = get_thread_cache();
+                if(!cache.dead)
+                {
+                    for(size_t i = 0; i < thread_cache::size; i++)
+                    {
+                        if(!cache.pools[i])
+                        {
+                            register_thread_cache_cleanup();
+                            cache.pools[i] = id_;
+                            cache.size_classes[i] = size_class;
+                            cache.buffers[i] = p;
+                            return;
+                        }
+                    }
+                }
+                if(give_back(p, size_class))
+                    return;
+            }
+#else
+            (void)n;
+#endif
+            details::aligned_free(p);
+        }
+
+    private:
+        /// Index of the smallest class of at least n bytes, size_classes_ if there is none
+        size_t get_size_class(size_t n) const
+        {
+            size_t size_class = 0;
+            while(size_class < size_classes_ && (buffer_size_ << size_class) < n)
+                size_class++;
+            return size_class;
+        }
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+        /// Index of the first shared slot of a class, the slots of all classes are stored consecutively
+        size_t slots_begin(size_t size_class) const
+        {
+            size_t begin = 0;
+            for(size_t i = 0; i < size_class; i++)
+                begin += std::max<size_t>(capacity_ >> i, 1);
+            return begin;
+        }
+        /// Put the buffer into a free shared slot of its class
+        bool give_back(char *p, size_t size_class)
+        {
+            for(size_t i = slots_begin(size_class); i < slots_begin(size_class + 1); i++)
+            {
+                char *expected = 0;
+                if(!slots_[i].load(std::memory_order_relaxed)
+                   && slots_[i].compare_exchange_strong(expected, p, std::memory_order_release, std::memory_order_relaxed))
+                    return true;
+            }
+            return false;
+        }
+
+        /// All existing pools, used to find the pool of a cached buffer at thread exit. Never destroyed
+        struct registry
+        {
+            std::mutex mutex;
+            std::vector<buffer_pool *> pools;
+            boost::uint64_t last_id;
+
+            registry() : last_id(0)
+            {}
+        };
+        static registry &get_registry()
+        {
+            static registry *const reg = new registry();
+            return *reg;
+        }
+
+        /// Buffers kept for the current thread. The pools are identified by a unique id, not by address, as another
+        /// pool may be created at the address of a destroyed one
+        struct thread_cache
+        {
+            static const size_t size = 4;
+            /// Id of the pool each buffer belongs to, 0 for unused entries
+            boost::uint64_t pools[size];
+            size_t size_classes[size];
+            char *buffers[size];
+            /// Set at thread exit, buffers returned afterwards go to the shared slots
+            bool dead;
+        };
+        /// Gives the cached buffers back to their pools when the thread exits
+        struct thread_cache_cleanup
+        {
+            ~thread_cache_cleanup()
+            {
+                thread_cache &cache = get_thread_cache();
+                cache.dead = true;
+                registry &reg = get_registry();
+                std::lock_guard<std::mutex> lock(reg.mutex);
+                for(size_t i = 0; i < thread_cache::size; i++)
+                {
+                    if(!cache.pools[i])
+                        continue;
+                    buffer_pool *pool = 0;
+                    for(size_t j = 0; j < reg.pools.size() && !pool; j++)
+                    {
+                        if(reg.pools[j]->id_ == cache.pools[i])
+                            pool = reg.pools[j];
+                    }
+                    if(!pool || !pool->give_back(cache.buffers[i], cache.size_classes[i]))
+                        details::aligned_free(cache.buffers[i]);
+                    cache.pools[i] = 0;
+                }
+            }
+        };
+        static thread_cache &get_thread_cache()
+        {
+            // Zero-initialized and trivially destructible, so it stays usable while other thread_locals are destroyed
+            static thread_local thread_cache cache;
+            return cache;
+        }
+        static void register_thread_cache_cleanup()
+        {
+            static thread_local thread_cache_cleanup cleanup;
+            (void)cleanup;
+        }
+#endif
+
+        size_t buffer_size_;
+        size_t size_classes_;
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+        boost::uint64_t id_;
+        size_t capacity_;
+        std::atomic<char *> *slots_;
+        std::atomic<size_t> hits_;
+        std::atomic<size_t> misses_;
+#endif
+    };
+
+} // namespace nowide
+} // namespace boost
+
+#endif
+
+// vim: tabstop=4 expandtab shiftwidth=4 softtabstop=4
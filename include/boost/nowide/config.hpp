@@ -48,5 +48,33 @@
 #define BOOST_NOWIDE_USE_WIN_FSTREAM 0
 #endif
 
+/// @def BOOST_NOWIDE_USE_FD_FILEBUF
+/// @brief Define to 1 to make boost::nowide::basic_filebuf use file descriptors (open/read/write/lseek)
+/// instead of C stdio.
+///
+/// Avoids the additional buffering and locking of FILE* as basic_filebuf already does its own buffering.
+/// Only has an effect if BOOST_NOWIDE_USE_WIN_FSTREAM is 1. Defaults to 0.
+#ifndef BOOST_NOWIDE_USE_FD_FILEBUF
+#define BOOST_NOWIDE_USE_FD_FILEBUF 0
+#endif
+
+/// @def BOOST_NOWIDE_USE_ASYNC_FILEBUF
+/// @brief Define to 1 to enable write-behind and read-ahead of boost::nowide::basic_filebuf
+///
+/// Those do the I/O in background threads, so the program has to be linked against the thread library
+/// (e.g. Threads::Threads in CMake, <threading>multi in Boost.Build). Requires C++11 threads.
+/// Only has an effect if BOOST_NOWIDE_USE_WIN_FSTREAM is 1. Defaults to 0.
+#ifndef BOOST_NOWIDE_USE_ASYNC_FILEBUF
+#define BOOST_NOWIDE_USE_ASYNC_FILEBUF 0
+#endif
+
+/// @def BOOST_NOWIDE_FILEBUF_BUFFER_SIZE
+/// @brief Initial value of boost::nowide::basic_filebuf<char>::default_buffer_size()
+///
+/// Defaults to 8192. BUFSIZ is not used as it is as small as 512 bytes on some platforms.
+#ifndef BOOST_NOWIDE_FILEBUF_BUFFER_SIZE
+#define BOOST_NOWIDE_FILEBUF_BUFFER_SIZE 8192
+#endif
+
 #endif // boost/nowide/config.hpp
 // vim: tabstop=4 expandtab shiftwidth=4 softtabstop=4
@@ -0,0 +1,179 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef BOOST_NOWIDE_COPY_FILE_HPP_INCLUDED
+#define BOOST_NOWIDE_COPY_FILE_HPP_INCLUDED
+
+#include <boost/nowide/config.hpp>
+#include <algorithm>
+#include <ios>
+#include <limits>
+#include <string>
+#include <vector>
+#ifndef BOOST_WINDOWS
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace boost {
+namespace nowide {
+
+    /// \cond INTERNAL
+    namespace details {
+#ifndef BOOST_WINDOWS
+        ///
+        /// Copy up to n bytes from the current position of in_fd to the current position of out_fd inside the kernel,
+        /// using copy_file_range (which can share the blocks on filesystems supporting reflinks) or sendfile.
+        ///
+        /// Returns the number of bytes copied. Stops at the end of the input, on errors and if not supported,
+        /// so the rest, if any, has to be copied with read and write.
+        ///
+        inline std::streamoff kernel_copy(int in_fd, int out_fd, std::streamoff n)
+        {
+            std::streamoff total = 0;
+#ifdef __linux__
+#ifdef __NR_copy_file_range
+            bool use_copy_file_range = true;
+#else
+            bool const use_copy_file_range = false;
+#endif
+            while(total < n)
+            {
+                size_t const chunk = static_cast<size_t>(std::min<std::streamoff>(n - total, 1 << 30));
+                long res;
+#ifdef __NR_copy_file_range
+                if(use_copy_file_range)
+                {
+                    void *const no_offset = 0;
+                    res = ::syscall(__NR_copy_file_range, in_fd, no_offset, out_fd, no_offset, chunk, 0u);
+                    // Not supported by the kernel or for these files (e.g. across filesystems before Linux 5.3)
+                    if(res < 0 && errno != EINTR)
+                    {
+                        use_copy_file_range = false;
+                        continue;
+                    }
+                } else
+#endif
+                    res = ::sendfile(out_fd, in_fd, 0, chunk);
+                if(res < 0 && errno == EINTR)
+                    continue;
+                // Some special files report EOF to copy_file_range, so let read confirm it
+                if(res <= 0)
+                    break;
+                total += res;
+            }
+            (void)use_copy_file_range;
+#else
+            (void)in_fd;
+            (void)out_fd;
+            (void)n;
+#endif
+            return total;
+        }
+        /// Copy the rest of in_fd to out_fd, returns false on error
+        inline bool copy_fd(int in_fd, int out_fd)
+        {
+            std::streamoff const max_size = (std::numeric_limits<std::streamoff>::max)();
+            kernel_copy(in_fd, out_fd, max_size);
+            std::vector<char> buf(64 * 1024);
+            for(;;)
+            {
+                ssize_t const n = ::read(in_fd, &buf[0], buf.size());
+                if(n < 0 && errno == EINTR)
+                    continue;
+                if(n < 0)
+                    return false;
+                if(n == 0)
+                    return true;
+                for(ssize_t written = 0; written < n;)
+                {
+                    ssize_t const res = ::write(out_fd, &buf[written], n - written);
+                    if(res < 0 && errno == EINTR)
+                        continue;
+                    if(res <= 0)
+                        return false;
+                    written += res;
+                }
+            }
+        }
+#endif
+    } // namespace details
+    /// \endcond
+
+    ///
+    /// \brief Copy the file from to the file to, both given as UTF-8 names. An existing file to is overwritten.
+    ///
+    /// The data is copied by the OS without passing it through user memory where possible: CopyFileExW on Windows;
+    /// a reflink (FICLONE), copy_file_range or sendfile on Linux. Otherwise it is read and written in blocks.
+    /// The permissions of from are copied on POSIX, also to an existing file to.
+    ///
+    /// Returns false on error, in which case to may be left incomplete
+    ///
+#ifdef BOOST_WINDOWS
+    BOOST_NOWIDE_DECL bool copy_file(char const *from, char const *to);
+#else
+    inline bool copy_file(char const *from, char const *to)
+    {
+        int in_fd;
+        do
+        {
+            in_fd = ::open(from, O_RDONLY);
+        } while(in_fd == -1 && errno == EINTR);
+        if(in_fd == -1)
+            return false;
+        struct stat in_st;
+        int out_fd = -1;
+        if(::fstat(in_fd, &in_st) == 0)
+        {
+            do
+            {
+                out_fd = ::open(to, O_WRONLY | O_CREAT, in_st.st_mode & 0777);
+            } while(out_fd == -1 && errno == EINTR);
+        }
+        bool res = false;
+        struct stat out_st;
+        // Don't truncate the source when copying a file onto itself
+        if(out_fd != -1 && ::fstat(out_fd, &out_st) == 0
+           && (in_st.st_dev != out_st.st_dev || in_st.st_ino != out_st.st_ino) && ::ftruncate(out_fd, 0) == 0)
+        {
+#ifdef FICLONE
+            res = ::ioctl(out_fd, FICLONE, in_fd) == 0;
+#endif
+            if(!res)
+                res = details::copy_fd(in_fd, out_fd);
+            // The mode given to open is subject to the umask and not applied to existing files
+            if(res && ::fchmod(out_fd, in_st.st_mode & 07777) != 0)
+                res = false;
+        }
+        if(out_fd != -1 && ::close(out_fd) != 0)
+            res = false;
+        ::close(in_fd);
+        return res;
+    }
+#endif
+    ///
+    /// \brief Copy the file from to the file to, both given as UTF-8 names, see copy_file(char const *, char const *)
+    ///
+    inline bool copy_file(std::string const &from, std::string const &to)
+    {
+        return copy_file(from.c_str(), to.c_str());
+    }
+
+} // namespace nowide
+} // namespace boost
+
+#endif
+
+// vim: tabstop=4 expandtab shiftwidth=4 softtabstop=4
@@ -11,17 +11,56 @@
 
 #include <boost/nowide/config.hpp>
 #if BOOST_NOWIDE_USE_WIN_FSTREAM
+#include <boost/nowide/buffer_pool.hpp>
+#include <boost/nowide/copy_file.hpp>
 #include <boost/nowide/stackstring.hpp>
+#include <boost/nowide/utf8_codecvt.hpp>
 #include <cassert>
-#include <limits>
 #include <streambuf>
 #include <ios>
 #include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <climits>
 #include <locale>
+#include <cerrno>
+#ifdef BOOST_WINDOWS
+#include <io.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+/// \cond INTERNAL
+#if BOOST_NOWIDE_USE_ASYNC_FILEBUF && !defined(BOOST_NO_CXX11_HDR_THREAD) && !defined(BOOST_NO_CXX11_HDR_MUTEX) \
+  && !defined(BOOST_NO_CXX11_HDR_CONDITION_VARIABLE)
+#define BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO 1
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#else
+#define BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO 0
+#endif
+/// \endcond
+#if BOOST_NOWIDE_USE_FD_FILEBUF
+#include <fcntl.h>
+#ifdef BOOST_WINDOWS
+#include <sys/stat.h>
+#else
+#include <sys/uio.h>
+#endif
+#endif
 #ifdef BOOST_NOWIDE_USE_FILESYSTEM
 #include <boost/filesystem/path.hpp>
 #endif
 #else
+#include <boost/nowide/utf8_codecvt.hpp>
+#include <locale>
 #ifdef BOOST_NOWIDE_USE_FILESYSTEM
 #include <boost/filesystem/fstream.hpp>
 #else
@@ -44,42 +83,2134 @@ namespace nowide {
 #endif
     using BOOST_NOWIDE_FS_NS::basic_filebuf;
     using BOOST_NOWIDE_FS_NS::filebuf;
+
+    namespace details {
+        /// loc with the conversion of wchar_t replaced by UTF-8
+        inline std::locale utf8_wide_locale(std::locale const &loc)
+        {
+            return std::locale(loc, new utf8_codecvt<wchar_t>());
+        }
+    } // namespace details
+
+    ///
+    /// \brief Same as std::wfilebuf but always reads and writes UTF-8
+    ///
+    class wfilebuf : public BOOST_NOWIDE_FS_NS::wfilebuf
+    {
+    public:
+        wfilebuf()
+        {
+            this->pubimbue(details::utf8_wide_locale(this->getloc()));
+        }
+    };
 #undef BOOST_NOWIDE_FS_NS
 #else // Windows
 
     ///
-    /// \brief This forward declaration defines the basic_filebuf type.
-    ///
-    /// it is implemented and specialized for CharType = char, it
-    /// implements std::filebuf over standard C I/O
+    /// \brief Hints about how a file is going to be accessed, see basic_filebuf<char>::access_hints
     ///
-    template<typename CharType, typename Traits = std::char_traits<CharType> >
-    class basic_filebuf;
+    enum file_access_hint
+    {
+        access_normal = 0,     ///< No special access pattern
+        access_sequential = 1, ///< The file is read sequentially, the OS can read ahead more aggressively
+        access_random = 2,     ///< The file is accessed randomly, read-ahead by the OS is not useful
+        access_will_need = 4,  ///< The content will be needed soon, the OS can start reading it into its cache
+        access_no_reuse = 8    ///< The content is used only once, the OS can drop it from its cache after use
+    };
 
     ///
-    /// \brief This is the implementation of std::filebuf
+    /// \brief A block of data to write with basic_filebuf<char>::write_iov, same as struct iovec
     ///
-    /// it is implemented and specialized for CharType = char, it
-    /// implements std::filebuf over standard C I/O
+    struct io_buffer
+    {
+        char const *data;
+        size_t size;
+    };
+
+    /// \cond INTERNAL
+    namespace details {
+        /// Alignment of buffers, file offsets and sizes for direct I/O
+        static const size_t direct_io_block_size = 4096;
+        /// Internal hint for the file backends to open the file for direct I/O
+        static const unsigned open_direct_io = 0x100;
+
+        /// Allocate a buffer for direct I/O: Block aligned and huge page backed if large enough and supported
+        inline char *allocate_direct_buffer(size_t n)
+        {
+#ifdef MADV_HUGEPAGE
+            size_t const huge_page_size = 2 * 1024 * 1024;
+            if(n >= huge_page_size)
+            {
+                char *const p = aligned_alloc(n, huge_page_size);
+                ::madvise(p, n, MADV_HUGEPAGE);
+                return p;
+            }
+#endif
+            return aligned_alloc(n, direct_io_block_size);
+        }
+
+        /// Write the buffers one after another, returns the number of bytes written
+        template<typename File>
+        size_t write_each(File &file, io_buffer const *buffers, size_t count)
+        {
+            size_t res = 0;
+            for(size_t i = 0; i < count; i++)
+            {
+                // Empty buffers may have a null data pointer which fwrite doesn't accept
+                if(!buffers[i].size)
+                    continue;
+                size_t const n = file.write(buffers[i].data, buffers[i].size);
+                res += n;
+                if(n != buffers[i].size)
+                    break;
+            }
+            return res;
+        }
+
+        /// Size of the file on disk or -1 on error and for anything but regular files (e.g. pipes) which have no size
+        inline std::streamoff file_size_fd(int fd)
+        {
+#ifdef BOOST_WINDOWS
+            struct _stati64 st;
+            if(::_fstati64(fd, &st) != 0 || (st.st_mode & _S_IFMT) != _S_IFREG)
+                return -1;
+#else
+            struct stat st;
+            if(::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+                return -1;
+#endif
+            return st.st_size;
+        }
+#ifdef BOOST_WINDOWS
+        /// Set the allocation size of the file handle h (FileAllocationInfo) without changing its size.
+        /// Implemented in the library as it needs the types from windows.h
+        BOOST_NOWIDE_DECL bool set_allocation_size(void *h, std::streamoff size);
+        /// Create the file name for writing with FILE_FLAG_NO_BUFFERING and return a descriptor for it or -1.
+        /// Only _O_TEXT of flags is used. Implemented in the library as it needs windows.h
+        BOOST_NOWIDE_DECL int open_direct_fd(wchar_t const *name, int flags);
+#endif
+        /// Allocate disk space for the first size bytes of the file. The file size is only changed if that is the only
+        /// way supported (posix_fallocate)
+        inline bool reserve_fd(int fd, std::streamoff size)
+        {
+            std::streamoff const cur_size = file_size_fd(fd);
+            if(cur_size < 0)
+                return false;
+            // Also avoids truncating the file on Windows
+            if(size <= cur_size)
+                return true;
+#ifdef BOOST_WINDOWS
+            return set_allocation_size(reinterpret_cast<void *>(::_get_osfhandle(fd)), size);
+#else
+            if(static_cast<std::streamoff>(static_cast<off_t>(size)) != size)
+                return false;
+#ifdef FALLOC_FL_KEEP_SIZE
+            int res;
+            do
+            {
+                res = ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+            } while(res == -1 && errno == EINTR);
+            if(res == 0)
+                return true;
+            if(errno != EOPNOTSUPP)
+                return false;
+#endif
+#if defined(_POSIX_ADVISORY_INFO) && _POSIX_ADVISORY_INFO > 0
+            // Returns the error instead of setting errno
+            int err;
+            do
+            {
+                err = ::posix_fallocate(fd, 0, static_cast<off_t>(size));
+            } while(err == EINTR);
+            return err == 0;
+#else
+            return false;
+#endif
+#endif
+        }
+#ifdef BOOST_WINDOWS
+        /// Append the fopen mode characters for the access hints to mode
+        inline void add_hints_to_mode(wchar_t const *mode, unsigned hints, wchar_t (&result)[8])
+        {
+            size_t i = 0;
+            for(; mode[i] && i < 5; i++)
+                result[i] = mode[i];
+            if(hints & access_sequential)
+                result[i++] = L'S';
+            else if(hints & access_random)
+                result[i++] = L'R';
+            result[i] = 0;
+        }
+#else
+        /// Pass the access hints to the OS for the file descriptor fd
+        inline void advise_fd(int fd, unsigned hints)
+        {
+#ifdef POSIX_FADV_NORMAL
+            int const pattern = (hints & access_sequential) ? POSIX_FADV_SEQUENTIAL :
+                                (hints & access_random)     ? POSIX_FADV_RANDOM :
+                                                              POSIX_FADV_NORMAL;
+            ::posix_fadvise(fd, 0, 0, pattern);
+            if(hints & access_will_need)
+                ::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            if(hints & access_no_reuse)
+                ::posix_fadvise(fd, 0, 0, POSIX_FADV_NOREUSE);
+#else
+            (void)fd;
+            (void)hints;
+#endif
+        }
+        /// Tell the OS that the cached content of the file isn't needed anymore
+        inline void drop_cache_fd(int fd)
+        {
+#ifdef POSIX_FADV_DONTNEED
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#else
+            (void)fd;
+#endif
+        }
+#endif
+
+        ///
+        /// \brief File backend of basic_filebuf using C stdio
+        ///
+        class stdio_file
+        {
+            // Non-copyable
+            stdio_file(const stdio_file &);
+            stdio_file &operator=(const stdio_file &);
+
+        public:
+            stdio_file() : file_(0)
+            {}
+            ~stdio_file()
+            {
+                close();
+            }
+            bool is_open() const
+            {
+                return file_ != 0;
+            }
+            void swap(stdio_file &rhs)
+            {
+                std::swap(file_, rhs.file_);
+            }
+            /// Open the file, mode is a mode string as used by fopen, hints a combination of file_access_hint
+            bool open(wchar_t const *name, wchar_t const *mode, unsigned hints)
+            {
+#ifdef BOOST_WINDOWS
+                wchar_t mode2[8];
+                add_hints_to_mode(mode, hints, mode2);
+                file_ = ::_wfopen(name, mode2);
+#else
+                stackstring const name2(name);
+                short_stackstring const mode2(mode);
+                file_ = std::fopen(name2.c_str(), mode2.c_str());
+                if(file_)
+                    advise(hints);
+#endif
+                return file_ != 0;
+            }
+            /// Pass access hints to the OS, not supported on Windows after opening
+            void advise(unsigned hints)
+            {
+#ifndef BOOST_WINDOWS
+                advise_fd(::fileno(file_), hints);
+#else
+                (void)hints;
+#endif
+            }
+            /// Drop the content of the file from the OS cache, if supported
+            void drop_cache()
+            {
+#ifndef BOOST_WINDOWS
+                drop_cache_fd(::fileno(file_));
+#endif
+            }
+            bool close()
+            {
+                if(!file_)
+                    return true;
+                bool const res = std::fclose(file_) == 0;
+                file_ = 0;
+                return res;
+            }
+            /// Read up to n bytes, returns the number of bytes read which is 0 on EOF or error
+            size_t read(char *buf, size_t n)
+            {
+                return std::fread(buf, 1, n, file_);
+            }
+            /// Write n bytes, returns the number of bytes written which is less than n on error
+            size_t write(char const *buf, size_t n)
+            {
+                return std::fwrite(buf, 1, n, file_);
+            }
+            /// Write the buffers in order, returns the number of bytes written
+            size_t write(io_buffer const *buffers, size_t count)
+            {
+                // Gathered by the stdio buffer
+                return write_each(*this, buffers, count);
+            }
+            bool flush()
+            {
+                return std::fflush(file_) == 0;
+            }
+            /// Set the size of the file
+            bool truncate(std::streamoff size)
+            {
+                if(!flush())
+                    return false;
+#ifdef BOOST_WINDOWS
+                return ::_chsize_s(::_fileno(file_), size) == 0;
+#else
+                return ::ftruncate(::fileno(file_), static_cast<off_t>(size)) == 0;
+#endif
+            }
+            /// Size of the file on disk, i.e. without data still in the stdio buffer. -1 on error
+            std::streamoff size()
+            {
+#ifdef BOOST_WINDOWS
+                return file_size_fd(::_fileno(file_));
+#else
+                return file_size_fd(::fileno(file_));
+#endif
+            }
+            /// Allocate disk space for a file of the given size
+            bool reserve(std::streamoff size)
+            {
+#ifdef BOOST_WINDOWS
+                return reserve_fd(::_fileno(file_), size);
+#else
+                return reserve_fd(::fileno(file_), size);
+#endif
+            }
+            static bool supports_direct_io()
+            {
+                return false;
+            }
+            /// Same as fseek but returns the new position or -1 on error. Supports 64 bit offsets
+            std::streamoff seek(std::streamoff off, int whence)
+            {
+#ifdef BOOST_WINDOWS
+                if(::_fseeki64(file_, off, whence) != 0)
+                    return -1;
+                return ::_ftelli64(file_);
+#else
+                // off_t is only 32 bit on some 32 bit systems without _FILE_OFFSET_BITS=64
+                if(static_cast<std::streamoff>(static_cast<off_t>(off)) != off)
+                    return -1;
+                if(::fseeko(file_, static_cast<off_t>(off), whence) != 0)
+                    return -1;
+                return ::ftello(file_);
+#endif
+            }
+
+        private:
+            FILE *file_;
+        };
+
+#if BOOST_NOWIDE_USE_FD_FILEBUF
+        ///
+        /// \brief File backend of basic_filebuf using file descriptors (open/read/write/lseek)
+        ///
+        /// Avoids the second buffer and the locking of C stdio as basic_filebuf does its own buffering.
+        ///
+        class fd_file
+        {
+            // Non-copyable
+            fd_file(const fd_file &);
+            fd_file &operator=(const fd_file &);
+
+        public:
+            fd_file() : fd_(-1)
+            {}
+            ~fd_file()
+            {
+                close();
+            }
+            bool is_open() const
+            {
+                return fd_ != -1;
+            }
+            void swap(fd_file &rhs)
+            {
+                std::swap(fd_, rhs.fd_);
+            }
+            /// Open the file, mode is a mode string as used by fopen, hints a combination of file_access_hint
+            bool open(wchar_t const *name, wchar_t const *mode, unsigned hints)
+            {
+                int flags;
+                bool const update = mode[1] == L'+' || (mode[1] && mode[2] == L'+');
+                switch(mode[0])
+                {
+                case L'r': flags = update ? O_RDWR : O_RDONLY; break;
+                case L'w': flags = (update ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC; break;
+                case L'a': flags = (update ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND; break;
+                default: return false;
+                }
+#ifdef BOOST_WINDOWS
+                bool const binary = mode[1] == L'b' || (mode[1] && mode[2] == L'b');
+                flags |= binary ? _O_BINARY : _O_TEXT;
+                if(hints & open_direct_io)
+                    return open_direct(name, flags);
+                if(hints & access_sequential)
+                    flags |= _O_SEQUENTIAL;
+                else if(hints & access_random)
+                    flags |= _O_RANDOM;
+                fd_ = ::_wopen(name, flags, _S_IREAD | _S_IWRITE);
+#else
+#ifdef O_DIRECT
+                if(hints & open_direct_io)
+                    flags |= O_DIRECT;
+#endif
+                stackstring const name2(name);
+                do
+                {
+                    fd_ = ::open(name2.c_str(), flags, 0666);
+                } while(fd_ == -1 && errno == EINTR);
+                if(fd_ != -1)
+                    advise(hints);
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+                if(fd_ != -1 && (hints & open_direct_io) && ::fcntl(fd_, F_NOCACHE, 1) == -1)
+                    close();
+#endif
+#endif
+                return fd_ != -1;
+            }
+            /// Pass access hints to the OS, not supported on Windows after opening
+            void advise(unsigned hints)
+            {
+#ifndef BOOST_WINDOWS
+                advise_fd(fd_, hints);
+#else
+                (void)hints;
+#endif
+            }
+            /// Drop the content of the file from the OS cache, if supported
+            void drop_cache()
+            {
+#ifndef BOOST_WINDOWS
+                drop_cache_fd(fd_);
+#endif
+            }
+            bool close()
+            {
+                if(fd_ == -1)
+                    return true;
+#ifdef BOOST_WINDOWS
+                bool const res = ::_close(fd_) == 0;
+#else
+                // Don't retry on EINTR, the descriptor is released anyway
+                bool const res = ::close(fd_) == 0;
+#endif
+                fd_ = -1;
+                return res;
+            }
+            /// Read up to n bytes, returns the number of bytes read which is 0 on EOF or error
+            ///
+            /// Unlike fread this may return less than n bytes before EOF, e.g. for pipes and terminals
+            size_t read(char *buf, size_t n)
+            {
+                for(;;)
+                {
+#ifdef BOOST_WINDOWS
+                    int const res = ::_read(fd_, buf, static_cast<unsigned>(std::min<size_t>(n, INT_MAX)));
+#else
+                    ssize_t const res = ::read(fd_, buf, n);
+#endif
+                    if(res >= 0)
+                        return static_cast<size_t>(res);
+                    if(errno != EINTR)
+                        return 0;
+                }
+            }
+            /// Write n bytes, returns the number of bytes written which is less than n on error
+            size_t write(char const *buf, size_t n)
+            {
+                size_t written = 0;
+                while(written < n)
+                {
+#ifdef BOOST_WINDOWS
+                    int const res = ::_write(fd_, buf + written, static_cast<unsigned>(std::min<size_t>(n - written, INT_MAX)));
+#else
+                    ssize_t const res = ::write(fd_, buf + written, n - written);
+#endif
+                    if(res < 0 && errno == EINTR)
+                        continue;
+                    if(res <= 0)
+                        break;
+                    written += static_cast<size_t>(res);
+                }
+                return written;
+            }
+            /// Write the buffers in order, using a single system call where possible.
+            /// Returns the number of bytes written
+            size_t write(io_buffer const *buffers, size_t count)
+            {
+#ifdef BOOST_WINDOWS
+                // WriteFileGather only works for unbuffered files with page sized buffers
+                return write_each(*this, buffers, count);
+#else
+                size_t res = 0;
+                while(count)
+                {
+                    iovec iov[16];
+                    int const n = static_cast<int>(std::min<size_t>(count, sizeof(iov) / sizeof(iov[0])));
+                    for(int i = 0; i < n; i++)
+                    {
+                        iov[i].iov_base = const_cast<char *>(buffers[i].data);
+                        iov[i].iov_len = buffers[i].size;
+                    }
+                    ssize_t written;
+                    do
+                    {
+                        written = ::writev(fd_, iov, n);
+                    } while(written < 0 && errno == EINTR);
+                    if(written < 0)
+                        break;
+                    res += static_cast<size_t>(written);
+                    // Skip the completely written buffers and finish a partially written one
+                    size_t left = static_cast<size_t>(written);
+                    int i = 0;
+                    for(; i < n && left >= buffers[i].size; i++)
+                        left -= buffers[i].size;
+                    if(i < n)
+                    {
+                        size_t const rest = buffers[i].size - left;
+                        size_t const n2 = write(buffers[i].data + left, rest);
+                        res += n2;
+                        if(n2 != rest)
+                            break;
+                        i++;
+                    }
+                    buffers += i;
+                    count -= i;
+                }
+                return res;
+#endif
+            }
+            bool flush()
+            {
+                // Nothing buffered
+                return true;
+            }
+            /// Set the size of the file
+            bool truncate(std::streamoff size)
+            {
+#ifdef BOOST_WINDOWS
+                return ::_chsize_s(fd_, size) == 0;
+#else
+                int res;
+                do
+                {
+                    res = ::ftruncate(fd_, static_cast<off_t>(size));
+                } while(res == -1 && errno == EINTR);
+                return res == 0;
+#endif
+            }
+            /// Size of the file on disk or -1 on error
+            std::streamoff size()
+            {
+                return file_size_fd(fd_);
+            }
+            /// Allocate disk space for a file of the given size
+            bool reserve(std::streamoff size)
+            {
+                return reserve_fd(fd_, size);
+            }
+            int native_handle() const
+            {
+                return fd_;
+            }
+            static bool supports_direct_io()
+            {
+#if defined(BOOST_WINDOWS) || defined(O_DIRECT) || defined(F_NOCACHE)
+                return true;
+#else
+                return false;
+#endif
+            }
+            /// Same as lseek but returns the new position or -1 on error
+            std::streamoff seek(std::streamoff off, int whence)
+            {
+#ifdef BOOST_WINDOWS
+                return ::_lseeki64(fd_, off, whence);
+#else
+                if(static_cast<std::streamoff>(static_cast<off_t>(off)) != off)
+                    return -1;
+                return ::lseek(fd_, static_cast<off_t>(off), whence);
+#endif
+            }
+
+        private:
+#ifdef BOOST_WINDOWS
+            /// Create a file for writing bypassing the OS cache, only supported for write-only files
+            bool open_direct(wchar_t const *name, int flags)
+            {
+                if(!(flags & _O_WRONLY) || (flags & _O_APPEND))
+                    return false;
+                fd_ = open_direct_fd(name, flags);
+                return fd_ != -1;
+            }
+#endif
+            int fd_;
+        };
+#endif
+
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+        ///
+        /// \brief Worker threads shared by all files doing background I/O
+        ///
+        /// Threads are started on demand up to a small limit and kept, so opening and closing many files doesn't
+        /// start and join a thread per file. The pool is never destroyed as files may still be closed during static
+        /// destruction, the idle threads are simply left waiting at exit.
+        ///
+        class async_io_pool
+        {
+            // Non-copyable
+            async_io_pool(const async_io_pool &);
+            async_io_pool &operator=(const async_io_pool &);
+
+        public:
+            /// An operation to run in a worker thread
+            class task
+            {
+            public:
+                virtual void run() = 0;
+
+            protected:
+                virtual ~task()
+                {}
+            };
+
+            static async_io_pool &instance()
+            {
+                static async_io_pool *const pool = new async_io_pool();
+                return *pool;
+            }
+            /// Queue t to be run by a worker thread. Returns false if no thread could be started, t is not run then
+            bool post(task &t)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queue_.push_back(&t);
+                if(queue_.size() > idle_ && threads_ < max_threads_)
+                {
+                    try
+                    {
+                        std::thread(&async_io_pool::work, this).detach();
+                        ++threads_;
+                    } catch(...)
+                    {
+                        if(threads_ == 0)
+                        {
+                            queue_.pop_back();
+                            return false;
+                        }
+                    }
+                }
+                cv_.notify_one();
+                return true;
+            }
+
+        private:
+            async_io_pool() :
+                idle_(0), threads_(0), max_threads_(std::min(std::max(std::thread::hardware_concurrency(), 2u), 8u))
+            {}
+            void work()
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                for(;;)
+                {
+                    ++idle_;
+                    while(queue_.empty())
+                        cv_.wait(lock);
+                    --idle_;
+                    task *const t = queue_.front();
+                    queue_.pop_front();
+                    lock.unlock();
+                    t->run();
+                    lock.lock();
+                }
+            }
+
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            std::deque<task *> queue_;
+            size_t idle_;
+            unsigned threads_;
+            unsigned const max_threads_;
+        };
+
+        ///
+        /// \brief Reads or writes data of a file in the background using the shared async_io_pool
+        ///
+        /// At most one operation is pending at a time, so the caller can use a second buffer meanwhile.
+        ///
+        template<typename File>
+        class async_io : private async_io_pool::task
+        {
+            // Non-copyable
+            async_io(const async_io &);
+            async_io &operator=(const async_io &);
+
+        public:
+            explicit async_io(File &file) :
+                file_(file), pending_(0), pending_size_(0), pending_read_(false), result_(0), ok_(true)
+            {}
+            ~async_io()
+            {
+                stop();
+            }
+            /// Wait for the previous operation and start writing n bytes from data which must stay valid until it is done.
+            /// Returns false if a previous write failed
+            bool write(char const *data, size_t n)
+            {
+                return start(const_cast<char *>(data), n, false);
+            }
+            /// Wait for the previous operation and start reading up to n bytes into data.
+            /// Returns false if a previous write failed
+            bool read(char *data, size_t n)
+            {
+                return start(data, n, true);
+            }
+            /// Wait for the pending operation. Returns false if any write failed since the last call
+            bool wait()
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while(pending_)
+                    cv_.wait(lock);
+                bool const res = ok_;
+                ok_ = true;
+                return res;
+            }
+            /// Wait for the pending read and return the number of bytes read
+            size_t wait_read()
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while(pending_)
+                    cv_.wait(lock);
+                return result_;
+            }
+            /// Finish the pending operation, after which this may be destroyed
+            void stop()
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while(pending_)
+                    cv_.wait(lock);
+            }
+
+        private:
+            bool start(char *data, size_t n, bool read)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    while(pending_)
+                        cv_.wait(lock);
+                    if(!ok_)
+                    {
+                        ok_ = true;
+                        return false;
+                    }
+                    pending_ = data;
+                    pending_size_ = n;
+                    pending_read_ = read;
+                }
+                // Do it right away if no thread is available
+                if(!async_io_pool::instance().post(*this))
+                    run();
+                return true;
+            }
+            virtual void run()
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                char *const data = pending_;
+                size_t const n = pending_size_;
+                bool const read = pending_read_;
+                lock.unlock();
+                size_t const res = read ? file_.read(data, n) : file_.write(data, n);
+                lock.lock();
+                if(!read && res != n)
+                    ok_ = false;
+                result_ = res;
+                pending_ = 0;
+                // Notify while holding the lock as the waiter may destroy this right after
+                cv_.notify_all();
+            }
+
+            File &file_;
+            std::mutex mutex_;
+            std::condition_variable cv_;
+            char *pending_;
+            size_t pending_size_;
+            bool pending_read_;
+            size_t result_;
+            bool ok_;
+        };
+#endif
+    } // namespace details
+    /// \endcond
+
+    ///
+    /// \brief This forward declaration defines the basic_filebuf type.
+    ///
+    /// It is specialized for CharType = char which implements std::filebuf over standard C I/O.
+    /// The generic version for wide characters converts from and to UTF-8 on top of it.
+    ///
+    template<typename CharType, typename Traits = std::char_traits<CharType> >
+    class basic_filebuf;
+
+    template<size_t N>
+    class static_filebuf;
+
+    ///
+    /// \brief This is the implementation of std::filebuf
+    ///
+    /// it is implemented and specialized for CharType = char, it
+    /// implements std::filebuf over standard C I/O
+    ///
+    template<>
+    class basic_filebuf<char> : public std::basic_streambuf<char>
+    {
+        // Non-copyable
+        basic_filebuf(const basic_filebuf<char> &);
+        basic_filebuf &operator=(const basic_filebuf<char> &);
+        template<size_t N>
+        friend class static_filebuf;
+
+        typedef std::char_traits<char> Traits;
+#if BOOST_NOWIDE_USE_FD_FILEBUF
+        typedef details::fd_file file_type;
+#else
+        typedef details::stdio_file file_type;
+#endif
+
+    public:
+        ///
+        /// Creates new filebuf
+        ///
+        basic_filebuf() :
+            buffer_size_(default_buffer_size()), buffer_(0), owns_buffer_(false), last_char_(0), mode_(std::ios_base::openmode(0)),
+            base_buffer_size_(0), max_buffer_size_(0), full_buffers_(0), seeks_(0), file_pos_(-1), back_buffer_(0), hints_(0),
+            write_behind_(false), read_ahead_(false), prefetching_(false), provider_(default_buffer_provider()),
+            direct_io_(false), data_end_(-1), embedded_buffer_(false)
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+            ,
+            io_(0)
+#endif
+        {
+            setg(0, 0, 0);
+            setp(0, 0);
+        }
+
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+        ///
+        /// Move constructor, takes over the file and buffer of other
+        ///
+        basic_filebuf(basic_filebuf &&other) :
+            buffer_size_(default_buffer_size()), buffer_(0), owns_buffer_(false), last_char_(0), mode_(std::ios_base::openmode(0)),
+            base_buffer_size_(0), max_buffer_size_(0), full_buffers_(0), seeks_(0), file_pos_(-1), back_buffer_(0), hints_(0),
+            write_behind_(false), read_ahead_(false), prefetching_(false), provider_(default_buffer_provider()),
+            direct_io_(false), data_end_(-1), embedded_buffer_(false)
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+            ,
+            io_(0)
+#endif
+        {
+            setg(0, 0, 0);
+            setp(0, 0);
+            swap(other);
+        }
+        ///
+        /// Move assignment, closes the current file and takes over the file and buffer of other
+        ///
+        basic_filebuf &operator=(basic_filebuf &&other)
+        {
+            if(this != &other)
+            {
+                close();
+                swap(other);
+            }
+            return *this;
+        }
+#endif
+
+        virtual ~basic_filebuf()
+        {
+            close();
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+            delete io_;
+#endif
+            if(back_buffer_)
+                deallocate_buffer(back_buffer_);
+        }
+
+        ///
+        /// Exchange the file, buffers, settings and locale with rhs
+        ///
+        void swap(basic_filebuf &rhs)
+        {
+            if(this == &rhs)
+                return;
+            // Background threads stay with their filebuf, so they need to be idle
+            wait_io();
+            rhs.wait_io();
+            if(embedded_buffer_ || rhs.embedded_buffer_)
+            {
+                swap_keeping_buffers(rhs);
+                return;
+            }
+            // Pointers to last_char_ need to be rebased as it is not swapped with its address
+            char *const lhs_areas[6] = {eback(), gptr(), egptr(), pbase(), pptr(), epptr()};
+            char *const rhs_areas[6] = {rhs.eback(), rhs.gptr(), rhs.egptr(), rhs.pbase(), rhs.pptr(), rhs.epptr()};
+            set_areas(rhs_areas, &rhs.last_char_);
+            rhs.set_areas(lhs_areas, &last_char_);
+            file_.swap(rhs.file_);
+            std::swap(buffer_size_, rhs.buffer_size_);
+            std::swap(buffer_, rhs.buffer_);
+            std::swap(owns_buffer_, rhs.owns_buffer_);
+            std::swap(last_char_, rhs.last_char_);
+            std::swap(mode_, rhs.mode_);
+            std::swap(base_buffer_size_, rhs.base_buffer_size_);
+            std::swap(max_buffer_size_, rhs.max_buffer_size_);
+            std::swap(full_buffers_, rhs.full_buffers_);
+            std::swap(seeks_, rhs.seeks_);
+            std::swap(file_pos_, rhs.file_pos_);
+            std::swap(back_buffer_, rhs.back_buffer_);
+            std::swap(hints_, rhs.hints_);
+            std::swap(write_behind_, rhs.write_behind_);
+            std::swap(read_ahead_, rhs.read_ahead_);
+            std::swap(provider_, rhs.provider_);
+            std::swap(direct_io_, rhs.direct_io_);
+            std::swap(data_end_, rhs.data_end_);
+            std::locale const loc = getloc();
+            pubimbue(rhs.getloc());
+            rhs.pubimbue(loc);
+        }
+
+        ///
+        /// Same as std::filebuf::open but s is UTF-8 string
+        ///
+        basic_filebuf *open(std::string const &s, std::ios_base::openmode mode)
+        {
+            return open(s.c_str(), mode);
+        }
+        ///
+        /// Same as std::filebuf::open but s is UTF-8 string
+        ///
+        basic_filebuf *open(char const *s, std::ios_base::openmode mode)
+        {
+            wstackstring const name(s);
+            return open(name.c_str(), mode);
+        }
+        basic_filebuf *open(wchar_t const *s, std::ios_base::openmode mode)
+        {
+            if(is_open())
+                return NULL;
+            validate_cvt(this->getloc());
+            bool const ate = bool(mode & std::ios_base::ate);
+            wchar_t const *smode = get_mode(mode);
+            if(!smode)
+                return 0;
+            unsigned hints = hints_;
+            if(direct_io_)
+            {
+                if(!can_use_direct_io(mode))
+                    return 0;
+                hints |= details::open_direct_io;
+                // Only whole blocks can be written
+                buffer_size_ = round_to_block(std::max<size_t>(buffer_size_, 1));
+                base_buffer_size_ = buffer_size_;
+            }
+            if(!file_.open(s, smode, hints))
+                return 0;
+            mode_ = mode;
+            file_pos_ = can_track_position() ? 0 : -1;
+            if(ate && seek_file(0, SEEK_END) < 0)
+            {
+                close();
+                return 0;
+            }
+            return this;
+        }
+#ifdef BOOST_NOWIDE_USE_FILESYSTEM
+        basic_filebuf *open(boost::filesystem::path const &s, std::ios_base::openmode mode)
+        {
+            return open(s.c_str(), mode);
+        }
+#endif
+        ///
+        /// Same as std::filebuf::close()
+        ///
+        basic_filebuf *close()
+        {
+            if(!is_open())
+                return NULL;
+            bool res = !direct_io_ || finish_direct_io();
+            if(sync() != 0)
+                res = false;
+            // Release the reserved space not written to
+            if(data_end_ >= 0 && !file_.truncate(data_end_))
+                res = false;
+            data_end_ = -1;
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+            if(io_)
+                io_->stop();
+#endif
+            if(hints_ & access_no_reuse)
+                file_.drop_cache();
+            if(!file_.close())
+                res = false;
+            mode_ = std::ios_base::openmode(0);
+            file_pos_ = -1;
+            // Don't keep pointers into a buffer which is going to be freed
+            setg(0, 0, 0);
+            setp(0, 0);
+            // Give the buffers back so they can be reused by other files
+            if(owns_buffer_)
+                free_buffer();
+            return res ? this : NULL;
+        }
+        ///
+        /// Same as std::filebuf::is_open()
+        ///
+        bool is_open() const
+        {
+            return file_.is_open();
+        }
+
+        ///
+        /// Write the count buffers in order and return the number of bytes written.
+        ///
+        /// If they don't fit into the buffer they are written together with the buffered data in a single system call
+        /// where possible (writev with the fd backend on POSIX), so e.g. a header and a payload don't need to be
+        /// assembled in memory first.
+        ///
+        std::streamsize write_iov(io_buffer const *buffers, size_t count)
+        {
+            if(!(mode_ & std::ios_base::out))
+                return 0;
+            size_t total = 0;
+            for(size_t i = 0; i < count; i++)
+                total += buffers[i].size;
+            if(total >= buffer_size_ && !direct_io_)
+                return write_direct(buffers, count);
+            // Small writes are copied into the buffer
+            std::streamsize res = 0;
+            for(size_t i = 0; i < count; i++)
+            {
+                std::streamsize const n = sputn(buffers[i].data, static_cast<std::streamsize>(buffers[i].size));
+                res += n;
+                if(n != static_cast<std::streamsize>(buffers[i].size))
+                    break;
+            }
+            return res;
+        }
+
+        ///
+        /// Copy up to n bytes from the current read position of this file to the current write position of dst.
+        ///
+        /// With the fd backend on Linux the data is copied by the kernel (copy_file_range or sendfile) without passing
+        /// it through user memory, except for data already buffered. Otherwise it is copied directly from the buffer
+        /// of this file into dst.
+        ///
+        /// Returns the number of bytes copied, which is less than n at the end of this file or on error
+        ///
+        std::streamsize transfer(basic_filebuf &dst, std::streamsize n)
+        {
+            if(&dst == this || !(mode_ & std::ios_base::in) || !(dst.mode_ & std::ios_base::out))
+                return 0;
+            std::streamsize res = 0;
+#if BOOST_NOWIDE_USE_FD_FILEBUF && defined(__linux__)
+            if(n > 0 && !direct_io_ && !dst.direct_io_)
+            {
+                // Hand over the buffered data first, then align the file positions with the logical positions
+                std::streamsize const buffered = std::min<std::streamsize>(n, egptr() - gptr());
+                res = copy_buffered(dst, buffered);
+                if(res != buffered || res == n)
+                    return res;
+                if(!start_reading() || !stop_reading() || !wait_io() || dst.pubsync() != 0 || !dst.wait_io())
+                    return res;
+                std::streamoff const copied =
+                  details::kernel_copy(file_.native_handle(), dst.file_.native_handle(), n - res);
+                if(file_pos_ >= 0)
+                    file_pos_ += copied;
+                if(dst.file_pos_ >= 0)
+                    dst.file_pos_ += copied;
+                dst.update_data_end();
+                res += static_cast<std::streamsize>(copied);
+            }
+#endif
+            // Through the get area
+            while(res < n)
+            {
+                if(gptr() == egptr() && underflow() == EOF)
+                    break;
+                std::streamsize const k = std::min<std::streamsize>(n - res, egptr() - gptr());
+                std::streamsize const copied = copy_buffered(dst, k);
+                res += copied;
+                if(copied != k)
+                    break;
+            }
+            return res;
+        }
+
+        ///
+        /// Preallocate disk space for a file of size bytes, so writing it up to that size doesn't extend it block by
+        /// block, which fragments the file and causes many metadata updates.
+        ///
+        /// Uses fallocate with FALLOC_FL_KEEP_SIZE on Linux and the allocation size on Windows, which don't change the
+        /// file size. Otherwise posix_fallocate is used which extends the file. Either way the file is cut to the end
+        /// of the written data on close, releasing the space not used.
+        ///
+        /// Requires a file open for writing whose position can be tracked, i.e. not in append mode and on Windows not
+        /// in text mode. Returns false if that or the preallocation fails.
+        ///
+        bool reserve(std::streamoff size)
+        {
+            if(!(mode_ & std::ios_base::out) || file_pos_ < 0 || size < 0)
+                return false;
+            if(data_end_ < 0)
+            {
+                std::streamoff const cur_size = file_.size();
+                if(cur_size < 0)
+                    return false;
+                data_end_ = std::max(cur_size, file_pos_);
+            }
+            return file_.reserve(size);
+        }
+
+        ///
+        /// Get the buffer size used by newly created filebufs
+        ///
+        static size_t default_buffer_size()
+        {
+            return default_buffer_size_storage();
+        }
+        ///
+        /// Set the buffer size used by newly created filebufs.
+        ///
+        /// Not thread-safe: Should be set once on startup before any filebuf is created
+        ///
+        static void default_buffer_size(size_t n)
+        {
+            default_buffer_size_storage() = n;
+        }
+        ///
+        /// Get the provider of the buffers of newly created filebufs, buffer_pool::global() by default
+        ///
+        static buffer_provider *default_buffer_provider()
+        {
+            return default_buffer_provider_storage();
+        }
+        ///
+        /// Set the provider of the buffers of newly created filebufs. It must outlive them.
+        ///
+        /// Not thread-safe: Should be set once on startup before any filebuf is created
+        ///
+        static void default_buffer_provider(buffer_provider *provider)
+        {
+            default_buffer_provider_storage() = provider;
+        }
+        ///
+        /// Get the provider of the internally allocated buffers
+        ///
+        buffer_provider *provider() const
+        {
+            return provider_;
+        }
+        ///
+        /// Set the provider of the internally allocated buffers. It must outlive the filebuf.
+        /// Fails if such a buffer is currently allocated.
+        ///
+        /// With direct_io() the buffers are always allocated block aligned by the filebuf itself, not by the provider.
+        ///
+        bool provider(buffer_provider *provider)
+        {
+            if(owns_buffer_ || back_buffer_)
+                return false;
+            provider_ = provider;
+            return true;
+        }
+        ///
+        /// Get the size of the current buffer. 0 means unbuffered
+        ///
+        size_t buffer_size() const
+        {
+            return buffer_size_;
+        }
+        ///
+        /// Set the size of the internally allocated buffer, replacing any buffer set via setbuf.
+        /// Meant as a hint before or directly after opening the file, so it fails if any I/O was done
+        /// since the last open, seek or sync.
+        ///
+        bool buffer_size(size_t n)
+        {
+            if(gptr() || pptr())
+                return false;
+            free_buffer();
+            buffer_size_ = n;
+            base_buffer_size_ = n;
+            return true;
+        }
+        ///
+        /// Enable adaptive buffering: The buffer is doubled, up to max_size, whenever it was completely filled or
+        /// drained several times in a row, i.e. for sequential access. When seeks happen repeatedly in between, i.e. for
+        /// random access, it is shrunk back to its initial size.
+        ///
+        /// Only affects buffers allocated by the filebuf, not those set via setbuf. Passing 0 disables it.
+        ///
+        void adaptive_buffer(size_t max_size)
+        {
+            max_buffer_size_ = max_size;
+            if(!base_buffer_size_)
+                base_buffer_size_ = buffer_size_;
+            full_buffers_ = seeks_ = 0;
+        }
+        ///
+        /// Enable or disable direct I/O for the next open: Data is written bypassing the OS cache (O_DIRECT,
+        /// F_NOCACHE on OSX, FILE_FLAG_NO_BUFFERING on Windows) from block aligned buffers, huge page backed if large
+        /// enough and supported. Only whole blocks are written, the rest on close after which the file is truncated
+        /// to its actual size. So a sync doesn't write the last partial block.
+        ///
+        /// Requires the fd backend (#BOOST_NOWIDE_USE_FD_FILEBUF) and an output-only binary mode without append.
+        /// Seeks other than tells fail. Open fails if the mode or filesystem doesn't support it.
+        /// Fails if the file is open or a buffer was set via setbuf.
+        ///
+        bool direct_io(bool enable)
+        {
+            if(is_open() || (buffer_ && !owns_buffer_) || (enable && !file_type::supports_direct_io()))
+                return false;
+            // Buffers are allocated differently
+            free_buffer();
+            direct_io_ = enable;
+            return true;
+        }
+        ///
+        /// Return whether direct I/O is enabled
+        ///
+        bool direct_io() const
+        {
+            return direct_io_;
+        }
+        ///
+        /// Enable or disable write-behind: Full buffers are written by a background thread while the next one is filled.
+        /// Any other operation on the file (sync, seek, read, close) waits for the pending write and reports its errors.
+        ///
+        /// Requires a buffer allocated by the filebuf, i.e. no effect with a buffer set via setbuf or when unbuffered.
+        /// Fails if any I/O was done since the last open, seek or sync or if not enabled by
+        /// BOOST_NOWIDE_USE_ASYNC_FILEBUF.
+        ///
+        bool write_behind(bool enable)
+        {
+            if(enable == write_behind_)
+                return true;
+            if(gptr() || (pptr() && pptr() != pbase()))
+                return false;
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+            write_behind_ = enable;
+            return true;
+#else
+            return false;
+#endif
+        }
+        ///
+        /// Enable or disable read-ahead: While the buffer is consumed, the next one is read by a background thread.
+        ///
+        /// Requires a buffer allocated by the filebuf and, on Windows, binary mode.
+        /// Seeks outside the buffer, writes and direct reads discard the data read ahead.
+        /// Fails if not enabled by BOOST_NOWIDE_USE_ASYNC_FILEBUF.
+        ///
+        bool read_ahead(bool enable)
+        {
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+            read_ahead_ = enable;
+            return true;
+#else
+            return !enable;
+#endif
+        }
+        ///
+        /// Set hints about how the file is going to be accessed, a combination of file_access_hint values.
+        ///
+        /// Uses posix_fadvise where available. On Windows only access_sequential and access_random are supported
+        /// and take effect on the next open. With access_no_reuse the file content is dropped from the OS cache on close.
+        ///
+        void access_hints(unsigned hints)
+        {
+            hints_ = hints;
+            if(is_open())
+                file_.advise(hints);
+        }
+        ///
+        /// Get the access hints, a combination of file_access_hint values
+        ///
+        unsigned access_hints() const
+        {
+            return hints_;
+        }
+
+    private:
+        /// Set get and put area from the pointers of another filebuf with its last_char_ at old_last_char
+        void set_areas(char *const (&areas)[6], char *old_last_char)
+        {
+            char *p[6];
+            for(int i = 0; i < 6; i++)
+                p[i] = (areas[i] == old_last_char || areas[i] == old_last_char + 1) ? &last_char_ + (areas[i] - old_last_char) : areas[i];
+            setg(p[0], p[1], p[2]);
+            setp(p[3], p[5]);
+            pbump(static_cast<int>(p[4] - p[3]));
+        }
+        static size_t &default_buffer_size_storage()
+        {
+            static size_t size = BOOST_NOWIDE_FILEBUF_BUFFER_SIZE;
+            return size;
+        }
+        static buffer_provider *&default_buffer_provider_storage()
+        {
+            static buffer_provider *provider = &buffer_pool::global();
+            return provider;
+        }
+        void free_buffer()
+        {
+            if(owns_buffer_)
+                deallocate_buffer(buffer_);
+            buffer_ = NULL;
+            owns_buffer_ = false;
+            if(back_buffer_)
+            {
+                // May still be in use by the background thread
+                wait_io();
+                deallocate_buffer(back_buffer_);
+                back_buffer_ = 0;
+            }
+        }
+        void make_buffer()
+        {
+            if(buffer_)
+                return;
+            if(buffer_size_ > 0)
+            {
+                buffer_ = allocate_buffer();
+                owns_buffer_ = true;
+            }
+        }
+        char *allocate_buffer()
+        {
+            if(direct_io_)
+                return details::allocate_direct_buffer(buffer_size_);
+            return provider_->allocate(buffer_size_);
+        }
+        void deallocate_buffer(char *p)
+        {
+            if(direct_io_)
+                details::aligned_free(p);
+            else
+                provider_->deallocate(p, buffer_size_);
+        }
+        static size_t round_to_block(size_t n)
+        {
+            size_t const block = details::direct_io_block_size;
+            return (n + block - 1) / block * block;
+        }
+        bool can_use_direct_io(std::ios_base::openmode mode) const
+        {
+            if(!(mode & std::ios_base::out) || (mode & (std::ios_base::in | std::ios_base::app)))
+                return false;
+#ifdef BOOST_WINDOWS
+            // Newline conversion would break the alignment
+            if(!(mode & std::ios_base::binary))
+                return false;
+#endif
+            return true;
+        }
+        /// Swap only the files as an embedded buffer can't change its owner. The buffered data is written or dropped
+        /// (for reading) first, the buffers and their settings stay with their filebuf
+        void swap_keeping_buffers(basic_filebuf &rhs)
+        {
+            basic_filebuf *const bufs[2] = {this, &rhs};
+            for(size_t i = 0; i < 2; i++)
+            {
+                if(bufs[i]->direct_io_)
+                    bufs[i]->finish_direct_io();
+                bufs[i]->sync();
+                bufs[i]->setg(0, 0, 0);
+                bufs[i]->setp(0, 0);
+            }
+            file_.swap(rhs.file_);
+            std::swap(mode_, rhs.mode_);
+            std::swap(file_pos_, rhs.file_pos_);
+            std::swap(hints_, rhs.hints_);
+            std::swap(data_end_, rhs.data_end_);
+            std::locale const loc = getloc();
+            pubimbue(rhs.getloc());
+            rhs.pubimbue(loc);
+        }
+        /// Write the remaining data padded to a whole block and cut the file to the actual size
+        bool finish_direct_io()
+        {
+            if(!pptr() || pptr() == pbase())
+                return true;
+            std::streamoff const size = position();
+            size_t const n = pptr() - pbase();
+            size_t const padded = round_to_block(n);
+            std::memset(pptr(), 0, padded - n);
+            char *const base = pbase();
+            setp(0, 0);
+            bool const res = write_file(base, padded) == padded;
+            // The padding is not part of the data
+            if(data_end_ >= 0)
+                data_end_ = size;
+            return res && file_.truncate(size);
+        }
+        void validate_cvt(const std::locale &loc)
+        {
+            if(!std::use_facet<std::codecvt<char, char, std::mbstate_t> >(loc).always_noconv())
+                throw std::runtime_error("Converting codecvts are not supported");
+        }
+
+    protected:
+        virtual std::streambuf *setbuf(char *s, std::streamsize n)
+        {
+            assert(n >= 0);
+            // Maximum compatibility: Discard all local buffers and use user-provided values
+            // Users should call sync() before or better use it before any IO is done or any file is opened
+            setg(NULL, NULL, NULL);
+            setp(NULL, NULL);
+            free_buffer();
+            buffer_ = s;
+            buffer_size_ = (n >= 0) ? n : 0;
+            base_buffer_size_ = buffer_size_;
+            return this;
+        }
+
+        virtual int overflow(int c = EOF)
+        {
+            if(!(mode_ & std::ios_base::out))
+                return EOF;
+
+            if(!start_writing())
+                return EOF;
+
+            size_t n = pptr() - pbase();
+            if(n > 0)
+            {
+                // With direct I/O only whole blocks can be written, the rest stays in the buffer
+                size_t const keep = direct_io_ ? n % details::direct_io_block_size : 0;
+                if(n > keep && !write_put_area(n - keep))
+                    return -1;
+                if(keep)
+                    std::memmove(buffer_, pbase() + (n - keep), keep);
+                setp(buffer_, buffer_ + buffer_size_);
+                pbump(static_cast<int>(keep));
+                if(c != EOF)
+                {
+                    *pptr() = c;
+                    pbump(1);
+                }
+            } else if(c != EOF)
+            {
+                if(buffer_size_ > 0)
+                {
+                    make_buffer();
+                    setp(buffer_, buffer_ + buffer_size_);
+                    *buffer_ = c;
+                    pbump(1);
+                } else if(!write_char(Traits::to_char_type(c)))
+                {
+                    return EOF;
+                } else if(!pptr())
+                {
+                    // Set to dummy value so we know we have writting something
+                    setp(&last_char_, &last_char_);
+                }
+            }
+            return Traits::not_eof(c);
+        }
+
+        virtual std::streamsize xsputn(const char *s, std::streamsize n)
+        {
+            // Small writes are copied into the buffer
+            // With direct I/O everything has to go through the aligned buffer
+            if(!(mode_ & std::ios_base::out) || n < static_cast<std::streamsize>(buffer_size_) || direct_io_)
+                return std::basic_streambuf<char>::xsputn(s, n);
+            // Larger ones go directly to the file together with the buffer avoiding the copy
+            io_buffer const buffer = {s, static_cast<size_t>(n)};
+            return write_direct(&buffer, 1);
+        }
+
+        virtual std::streamsize xsgetn(char *s, std::streamsize n)
+        {
+            std::streamsize const avail = gptr() ? egptr() - gptr() : 0;
+            // Small reads are served from the buffer
+            if(!(mode_ & std::ios_base::in) || n - avail < static_cast<std::streamsize>(buffer_size_))
+                return std::basic_streambuf<char>::xsgetn(s, n);
+            // Larger ones consume the buffer and read the rest directly from the file avoiding the copy
+            if(avail > 0)
+            {
+                std::memcpy(s, gptr(), static_cast<size_t>(avail));
+                gbump(static_cast<int>(avail));
+                s += avail;
+                n -= avail;
+            }
+            if(!start_reading())
+                return avail;
+            std::streamsize read = 0;
+            while(read < n)
+            {
+                size_t const res = read_file(s + read, static_cast<size_t>(n - read));
+                if(res == 0)
+                    break;
+                read += static_cast<std::streamsize>(res);
+            }
+            // Mark that we are reading with an empty get area
+            setg(&last_char_, &last_char_, &last_char_);
+            return avail + read;
+        }
+
+        virtual int sync()
+        {
+            if(!is_open())
+                return 0;
+            bool result;
+            if(pptr())
+            {
+                result = overflow() != EOF;
+                // Only flush if anything was written, otherwise behavior of fflush is undefined
+                if(!wait_io() || !file_.flush())
+                    result = false;
+            } else
+                result = stop_reading();
+            return result ? 0 : -1;
+        }
+
+        virtual int underflow()
+        {
+            if(!(mode_ & std::ios_base::in))
+                return EOF;
+            if(!start_reading())
+                return EOF;
+            if(buffer_ && eback() == buffer_ && static_cast<size_t>(egptr() - eback()) == buffer_size_)
+                count_full_buffer();
+            if(buffer_size_ == 0)
+            {
+                if(read_file(&last_char_, 1) != 1)
+                    return EOF;
+                setg(&last_char_, &last_char_, &last_char_ + 1);
+            } else
+            {
+                make_buffer();
+                size_t const n = read_buffer();
+                setg(buffer_, buffer_, buffer_ + n);
+                if(n == 0)
+                    return EOF;
+            }
+            return Traits::to_int_type(*gptr());
+        }
+
+        virtual int pbackfail(int c = EOF)
+        {
+            if(!(mode_ & std::ios_base::in))
+                return EOF;
+            if(!start_reading())
+                return EOF;
+            if(gptr() > eback())
+                gbump(-1);
+            else if(seekoff(-1, std::ios_base::cur) != std::streampos(std::streamoff(-1)))
+            {
+                if(underflow() == EOF)
+                    return EOF;
+            } else
+                return EOF;
+
+            // Case 1: Caller just wanted space for 1 char
+            if(c == EOF)
+                return Traits::not_eof(c);
+            // Case 2: Caller wants to put back different char
+            // gptr now points to the (potentially newly read) previous char
+            if(*gptr() != c)
+                *gptr() = Traits::to_char_type(c);
+            return Traits::not_eof(c);
+        }
+
+        /// Number of bytes from the current position to the end of the file, so in_avail() and readsome() see the
+        /// whole remaining file and not only the get area. -1 at or after the end of the file, 0 if unknown,
+        /// e.g. for pipes or in append or Windows text mode.
+        virtual std::streamsize showmanyc()
+        {
+            if(!(mode_ & std::ios_base::in) || file_pos_ < 0)
+                return 0;
+            std::streamoff const pos = position();
+            // The file may be larger than the data written so far if space was reserved by changing its size
+            std::streamoff const end = (data_end_ >= 0) ? std::max(data_end_, pos) : file_.size();
+            if(end < 0)
+                return 0;
+            if(end <= pos)
+                return -1;
+            return static_cast<std::streamsize>(end - pos);
+        }
+
+        virtual std::streampos
+        seekoff(std::streamoff off, std::ios_base::seekdir seekdir, std::ios_base::openmode = std::ios_base::in | std::ios_base::out)
+        {
+            if(!is_open())
+                return EOF;
+            if(file_pos_ >= 0 && seekdir != std::ios_base::end)
+            {
+                std::streamoff const cur = position();
+                std::streamoff const target = (seekdir == std::ios_base::beg) ? off : cur + off;
+                // A tell doesn't need to flush or seek as the position is known.
+                // Switching between input<->output still does a seek, see start_reading/start_writing
+                if(target == cur)
+                    return cur;
+                // Move inside the get area if possible
+                if(gptr())
+                {
+                    std::streamoff const start = file_pos_ - (egptr() - eback());
+                    if(target >= start && target <= file_pos_)
+                    {
+                        setg(eback(), eback() + static_cast<size_t>(target - start), egptr());
+                        return target;
+                    }
+                }
+            }
+
+            // Only whole blocks at aligned positions can be written
+            if(direct_io_)
+                return EOF;
+            // On some implementations a seek also flushes, so do a full sync
+            if(sync() != 0)
+                return EOF;
+            if(off != 0 || seekdir != std::ios_base::cur)
+                count_seek();
+            int whence;
+            switch(seekdir)
+            {
+            case std::ios_base::beg: whence = SEEK_SET; break;
+            case std::ios_base::cur: whence = SEEK_CUR; break;
+            case std::ios_base::end: whence = SEEK_END; break;
+            default: assert(false); return EOF;
+            }
+            return seek_file(off, whence);
+        }
+        virtual std::streampos seekpos(std::streampos pos, std::ios_base::openmode m = std::ios_base::in | std::ios_base::out)
+        {
+            // Standard mandates "as-if fsetpos", but assume the effect is the same as fseek
+            return seekoff(pos, std::ios_base::beg, m);
+        }
+        virtual void imbue(const std::locale &loc)
+        {
+            validate_cvt(loc);
+        }
+
+    private:
+        /// Stop reading adjusting the file pointer if neccessary
+        /// Postcondition: gptr() == NULL
+        bool stop_reading()
+        {
+            if(gptr())
+            {
+                std::streamoff const off = gptr() - egptr();
+                setg(0, 0, 0);
+                if(off && seek_file(off, SEEK_CUR) < 0)
+                    return false;
+            }
+            return true;
+        }
+
+        /// Stop writing. If any bytes are to be written, writes them to file
+        /// Postcondition: pptr() == NULL
+        bool stop_writing()
+        {
+            if(pptr())
+            {
+                const char *const base = pbase();
+                size_t const n = pptr() - base;
+                setp(0, 0);
+                if(n && write_file(base, n) != n)
+                    return false;
+            }
+            return true;
+        }
+
+        /// Stop writing and prepare for reading.
+        /// Switching from output to input requires a flush or seek of the file
+        bool start_reading()
+        {
+            if(!pptr())
+                return true;
+            return stop_writing() && wait_io() && file_.flush();
+        }
+
+        /// Stop reading and prepare for writing.
+        /// Switching from input to output requires a seek even if it doesn't change the position
+        bool start_writing()
+        {
+            if(gptr() && gptr() == egptr())
+            {
+                setg(0, 0, 0);
+                return seek_file(0, SEEK_CUR) >= 0;
+            }
+            return stop_reading();
+        }
+
+        /// Write the n bytes of the put area, in the background if write-behind is enabled.
+        /// The put area has to be reset afterwards as buffer_ might have changed
+        bool write_put_area(size_t n)
+        {
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+            if(write_behind_ && owns_buffer_ && pbase() == buffer_)
+            {
+                if(!back_buffer_)
+                    back_buffer_ = allocate_buffer();
+                if(!get_io().write(buffer_, n))
+                    return false;
+                if(file_pos_ >= 0)
+                    file_pos_ += n;
+                update_data_end();
+                // Continue with the other buffer
+                std::swap(buffer_, back_buffer_);
+                return true;
+            }
+#endif
+            if(write_file(pbase(), n) != n)
+                return false;
+            if(pbase() == buffer_ && n == buffer_size_)
+                count_full_buffer();
+            return true;
+        }
+
+        bool write_char(char c)
+        {
+            return write_file(&c, 1) == 1;
+        }
+
+        /// The file position can only be tracked if each byte in the buffer is a byte in the file
+        /// (no newline conversion in text mode on Windows) and writes don't jump to the end (append mode)
+        bool can_track_position() const
+        {
+            if(mode_ & std::ios_base::app)
+                return false;
+#ifdef BOOST_WINDOWS
+            if(!(mode_ & std::ios_base::binary))
+                return false;
+#endif
+            return true;
+        }
+
+        /// Current logical position in the file, only valid if file_pos_ is known
+        std::streamoff position() const
+        {
+            if(gptr())
+                return file_pos_ - (egptr() - gptr());
+            else if(pptr())
+                return file_pos_ + (pptr() - pbase());
+            else
+                return file_pos_;
+        }
+
+        /// Read into the buffer, using and restarting read-ahead if enabled
+        size_t read_buffer()
+        {
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+            // The position is required to undo a read-ahead
+            if(read_ahead_ && owns_buffer_ && file_pos_ >= 0)
+            {
+                size_t n;
+                if(prefetching_)
+                {
+                    // The next buffer was already read in the background
+                    prefetching_ = false;
+                    n = io_->wait_read();
+                    file_pos_ += n;
+                    std::swap(buffer_, back_buffer_);
+                } else
+                    n = read_file(buffer_, buffer_size_);
+                if(n == buffer_size_)
+                {
+                    if(!back_buffer_)
+                        back_buffer_ = allocate_buffer();
+                    prefetching_ = get_io().read(back_buffer_, buffer_size_);
+                }
+                return n;
+            }
+#endif
+            return read_file(buffer_, buffer_size_);
+        }
+
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+        details::async_io<file_type> &get_io()
+        {
+            if(!io_)
+                io_ = new details::async_io<file_type>(file_);
+            return *io_;
+        }
+#endif
+
+        /// Wait for any pending background operation, discarding data read ahead.
+        /// Returns false if a background write failed
+        bool wait_io()
+        {
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+            if(!io_)
+                return true;
+            if(prefetching_)
+            {
+                prefetching_ = false;
+                size_t const n = io_->wait_read();
+                // Move the file position back to the start of the data read ahead
+                if(n && file_.seek(-static_cast<std::streamoff>(n), SEEK_CUR) < 0)
+                {
+                    file_pos_ = -1;
+                    return false;
+                }
+            }
+            return io_->wait();
+#else
+            return true;
+#endif
+        }
+
+        /// Wrappers of file_ functions updating file_pos_ and waiting for background writes
+        size_t read_file(char *s, size_t n)
+        {
+            if(!wait_io())
+                return 0;
+            size_t const res = file_.read(s, n);
+            if(file_pos_ >= 0)
+                file_pos_ += res;
+            return res;
+        }
+        size_t write_file(char const *s, size_t n)
+        {
+            if(!wait_io())
+                return 0;
+            size_t const res = file_.write(s, n);
+            if(file_pos_ >= 0)
+                file_pos_ += res;
+            update_data_end();
+            return res;
+        }
+        size_t write_file(io_buffer const *buffers, size_t count)
+        {
+            if(!wait_io())
+                return 0;
+            size_t const res = file_.write(buffers, count);
+            if(file_pos_ >= 0)
+                file_pos_ += res;
+            update_data_end();
+            return res;
+        }
+
+        /// Write the put area followed by the buffers without copying them, using a single system call if possible.
+        /// Returns the number of bytes written from the buffers
+        std::streamsize write_direct(io_buffer const *buffers, size_t count)
+        {
+            if(!start_writing())
+                return 0;
+            io_buffer gathered[16];
+            size_t const max_buffers = sizeof(gathered) / sizeof(gathered[0]) - 1;
+            gathered[0].data = pbase();
+            gathered[0].size = pptr() ? pptr() - pbase() : 0;
+            size_t const pending = gathered[0].size;
+            size_t const first = std::min(count, max_buffers);
+            size_t first_size = 0;
+            for(size_t i = 0; i < first; i++)
+            {
+                gathered[i + 1] = buffers[i];
+                first_size += buffers[i].size;
+            }
+            setp(0, 0);
+            size_t written = write_file(gathered, first + 1);
+            if(written < pending)
+                return 0;
+            written -= pending;
+            if(written == first_size && count > first)
+                written += write_file(buffers + first, count - first);
+            // Mark that we are writing so sync() flushes the file
+            if(buffer_)
+                setp(buffer_, buffer_ + buffer_size_);
+            else
+                setp(&last_char_, &last_char_);
+            return static_cast<std::streamsize>(written);
+        }
+        /// Write n bytes of the get area to dst and consume them, returns the number of bytes written
+        std::streamsize copy_buffered(basic_filebuf &dst, std::streamsize n)
+        {
+            if(n <= 0)
+                return 0;
+            std::streamsize const res = dst.sputn(gptr(), n);
+            gbump(static_cast<int>(res));
+            return res;
+        }
+        /// Track the end of the written data while space is reserved
+        void update_data_end()
+        {
+            if(data_end_ >= 0 && file_pos_ > data_end_)
+                data_end_ = file_pos_;
+        }
+        std::streamoff seek_file(std::streamoff off, int whence)
+        {
+            if(!wait_io())
+                return -1;
+            std::streamoff const res = file_.seek(off, whence);
+            file_pos_ = (res >= 0 && can_track_position()) ? res : -1;
+            return res;
+        }
+
+        /// Number of consecutive full buffers or seeks after which adaptive buffering changes the buffer size
+        static const unsigned adapt_threshold = 4;
+
+        /// Called when the buffer was completely filled or drained and is about to be reused
+        void count_full_buffer()
+        {
+            seeks_ = 0;
+            if(!max_buffer_size_ || !owns_buffer_ || buffer_size_ >= max_buffer_size_)
+                return;
+            if(++full_buffers_ >= adapt_threshold)
+            {
+                full_buffers_ = 0;
+                resize_buffer(std::min(buffer_size_ * 2, max_buffer_size_));
+            }
+        }
+
+        /// Called on seeks which (potentially) change the position
+        void count_seek()
+        {
+            full_buffers_ = 0;
+            if(!max_buffer_size_ || !owns_buffer_ || buffer_size_ <= base_buffer_size_)
+                return;
+            if(++seeks_ >= adapt_threshold)
+            {
+                seeks_ = 0;
+                // After a sync the put area is empty and the get area is unset
+                assert(!gptr() && pptr() == pbase());
+                bool const writing = pptr() == buffer_;
+                resize_buffer(base_buffer_size_);
+                if(writing)
+                    setp(buffer_, buffer_ + buffer_size_);
+            }
+        }
+
+        /// Replace the (unused) owned buffer by one of the given size
+        void resize_buffer(size_t n)
+        {
+            assert(owns_buffer_);
+            if(direct_io_)
+                n = round_to_block(n);
+            free_buffer();
+            buffer_size_ = n;
+            make_buffer();
+        }
+
+        static wchar_t const *get_mode(std::ios_base::openmode mode)
+        {
+            // Flag out ate
+            mode = static_cast<std::ios_base::openmode>(static_cast<unsigned>(mode) & ~static_cast<unsigned>(std::ios_base::ate));
+            //
+            // done according to n2914 table 106 27.9.1.4
+            //
+
+            // note can't use switch case as overload operator can't be used
+            // in constant expression
+            if(mode == (std::ios_base::out))
+                return L"w";
+            if(mode == (std::ios_base::out | std::ios_base::app))
+                return L"a";
+            if(mode == (std::ios_base::app))
+                return L"a";
+            if(mode == (std::ios_base::out | std::ios_base::trunc))
+                return L"w";
+            if(mode == (std::ios_base::in))
+                return L"r";
+            if(mode == (std::ios_base::in | std::ios_base::out))
+                return L"r+";
+            if(mode == (std::ios_base::in | std::ios_base::out | std::ios_base::trunc))
+                return L"w+";
+            if(mode == (std::ios_base::in | std::ios_base::out | std::ios_base::app))
+                return L"a+";
+            if(mode == (std::ios_base::in | std::ios_base::app))
+                return L"a+";
+            if(mode == (std::ios_base::binary | std::ios_base::out))
+                return L"wb";
+            if(mode == (std::ios_base::binary | std::ios_base::out | std::ios_base::app))
+                return L"ab";
+            if(mode == (std::ios_base::binary | std::ios_base::app))
+                return L"ab";
+            if(mode == (std::ios_base::binary | std::ios_base::out | std::ios_base::trunc))
+                return L"wb";
+            if(mode == (std::ios_base::binary | std::ios_base::in))
+                return L"rb";
+            if(mode == (std::ios_base::binary | std::ios_base::in | std::ios_base::out))
+                return L"r+b";
+            if(mode == (std::ios_base::binary | std::ios_base::in | std::ios_base::out | std::ios_base::trunc))
+                return L"w+b";
+            if(mode == (std::ios_base::binary | std::ios_base::in | std::ios_base::out | std::ios_base::app))
+                return L"a+b";
+            if(mode == (std::ios_base::binary | std::ios_base::in | std::ios_base::app))
+                return L"a+b";
+            return 0;
+        }
+
+        size_t buffer_size_;
+        char *buffer_;
+        file_type file_;
+        bool owns_buffer_;
+        char last_char_;
+        std::ios::openmode mode_;
+        /// Initial buffer size for adaptive buffering
+        size_t base_buffer_size_;
+        /// Maximum buffer size for adaptive buffering, 0 if disabled
+        size_t max_buffer_size_;
+        unsigned full_buffers_;
+        unsigned seeks_;
+        /// Position of the underlying file, i.e. of egptr() while reading or pbase() while writing. -1 if unknown
+        std::streamoff file_pos_;
+        /// Second buffer for write-behind and read-ahead
+        char *back_buffer_;
+        unsigned hints_;
+        bool write_behind_;
+        bool read_ahead_;
+        /// True if the next buffer is being read in the background
+        bool prefetching_;
+        buffer_provider *provider_;
+        bool direct_io_;
+        /// End of the written data while space is reserved, -1 otherwise
+        std::streamoff data_end_;
+        /// The buffer is part of the object (static_filebuf) and must not be swapped
+        bool embedded_buffer_;
+#if BOOST_NOWIDE_FILEBUF_HAS_ASYNC_IO
+        details::async_io<file_type> *io_;
+#endif
+    };
+
+    ///
+    /// \brief Convenience typedef
+    ///
+    typedef basic_filebuf<char> filebuf;
+
+    ///
+    /// \brief filebuf with a buffer of N bytes embedded in the object
+    ///
+    /// Doesn't allocate any memory for buffering, so used with the fd backend (#BOOST_NOWIDE_USE_FD_FILEBUF) open, I/O
+    /// and close don't allocate as long as the file name fits into a stackstring. Use with std::istream, std::ostream
+    /// or std::iostream.
+    ///
+    /// Write-behind and read-ahead are not available. As the buffer is part of the object it is not copyable or movable.
+    /// Swapping with any filebuf, also via moving a basic_filebuf, only exchanges the files: The buffered data is
+    /// written first and each filebuf keeps its buffer.
+    ///
+    template<size_t N>
+    class static_filebuf : public basic_filebuf<char>
+    {
+        // Non-copyable and non-movable
+        static_filebuf(const static_filebuf &);
+        static_filebuf &operator=(const static_filebuf &);
+
+    public:
+        static_filebuf()
+        {
+            this->setbuf(storage_, N);
+            this->embedded_buffer_ = true;
+        }
+        ~static_filebuf()
+        {
+            // Flush while the buffer still exists
+            this->close();
+        }
+        ///
+        /// Size of the embedded buffer
+        ///
+        static size_t static_buffer_size()
+        {
+            return N;
+        }
+
+    private:
+        char storage_[N];
+    };
+
+    ///
+    /// Swap the two filebufs
+    ///
+    template<typename CharType, typename Traits>
+    void swap(basic_filebuf<CharType, Traits> &lhs, basic_filebuf<CharType, Traits> &rhs)
+    {
+        lhs.swap(rhs);
+    }
+    ///
+    /// Swap the files of the two filebufs, each keeps its embedded buffer
+    ///
+    template<size_t N>
+    void swap(static_filebuf<N> &lhs, static_filebuf<N> &rhs)
+    {
+        lhs.swap(rhs);
+    }
+
+    ///
+    /// \brief Implementation of std::basic_filebuf for the wide character types wchar_t, char16_t and char32_t
+    ///
+    /// The file content is always UTF-8, independent of the imbued locale. Bytes are read and written in blocks by a
+    /// basic_filebuf<char> and converted in bulk with utf8_codecvt::convert_in and utf8_codecvt::convert_out.
+    /// Invalid UTF-8 is replaced by U+FFFD.
     ///
-    template<>
-    class basic_filebuf<char> : public std::basic_streambuf<char>
+    /// As UTF-8 has a variable length, seeks are only supported to the start or end of the file and to positions
+    /// previously returned by a tell.
+    ///
+    template<typename CharType, typename Traits>
+    class basic_filebuf : public std::basic_streambuf<CharType, Traits>
     {
         // Non-copyable
-        basic_filebuf(const basic_filebuf<char> &);
-        basic_filebuf &operator=(const basic_filebuf<char> &);
+        basic_filebuf(const basic_filebuf &);
+        basic_filebuf &operator=(const basic_filebuf &);
 
-        typedef std::char_traits<char> Traits;
+        typedef std::basic_streambuf<CharType, Traits> base_type;
+        typedef utf8_codecvt<CharType> cvt_type;
 
     public:
+        typedef CharType char_type;
+        typedef Traits traits_type;
+        typedef typename Traits::int_type int_type;
+        typedef typename Traits::pos_type pos_type;
+        typedef typename Traits::off_type off_type;
+
         ///
         /// Creates new filebuf
         ///
-        basic_filebuf() : buffer_size_(BUFSIZ), buffer_(0), file_(0), owns_buffer_(false), last_char_(0), mode_(std::ios_base::openmode(0))
+        basic_filebuf() :
+            buffer_size_(std::max<size_t>(basic_filebuf<char>::default_buffer_size(), 16)), buffer_(0), raw_(0), raw_begin_(0),
+            raw_end_(0), area_begin_(0), state_(), area_state_(), mode_(std::ios_base::openmode(0))
         {
-            setg(0, 0, 0);
-            setp(0, 0);
+            // The bytes go directly between the file and raw_, no need for another buffer in between
+            bytes_.buffer_size(0);
+            this->setg(0, 0, 0);
+            this->setp(0, 0);
+        }
+
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+        ///
+        /// Move constructor, takes over the file and buffers of other
+        ///
+        basic_filebuf(basic_filebuf &&other) :
+            buffer_size_(std::max<size_t>(basic_filebuf<char>::default_buffer_size(), 16)), buffer_(0), raw_(0), raw_begin_(0),
+            raw_end_(0), area_begin_(0), state_(), area_state_(), mode_(std::ios_base::openmode(0))
+        {
+            bytes_.buffer_size(0);
+            this->setg(0, 0, 0);
+            this->setp(0, 0);
+            swap(other);
+        }
+        ///
+        /// Move assignment, closes the current file and takes over the file and buffers of other
+        ///
+        basic_filebuf &operator=(basic_filebuf &&other)
+        {
+            if(this != &other)
+            {
+                close();
+                swap(other);
+            }
+            return *this;
         }
+#endif
 
         virtual ~basic_filebuf()
         {
@@ -87,14 +2218,40 @@ namespace nowide {
         }
 
         ///
-        /// Same as std::filebuf::open but s is UTF-8 string
+        /// Exchange the file, buffers and locale with rhs
+        ///
+        void swap(basic_filebuf &rhs)
+        {
+            if(this == &rhs)
+                return;
+            // The areas point into the heap allocated buffers which are swapped too
+            CharType *const lhs_areas[6] = {this->eback(), this->gptr(), this->egptr(), this->pbase(), this->pptr(), this->epptr()};
+            set_areas(rhs.eback(), rhs.gptr(), rhs.egptr(), rhs.pbase(), rhs.pptr(), rhs.epptr());
+            rhs.set_areas(lhs_areas[0], lhs_areas[1], lhs_areas[2], lhs_areas[3], lhs_areas[4], lhs_areas[5]);
+            bytes_.swap(rhs.bytes_);
+            std::swap(buffer_size_, rhs.buffer_size_);
+            std::swap(buffer_, rhs.buffer_);
+            std::swap(raw_, rhs.raw_);
+            std::swap(raw_begin_, rhs.raw_begin_);
+            std::swap(raw_end_, rhs.raw_end_);
+            std::swap(area_begin_, rhs.area_begin_);
+            std::swap(state_, rhs.state_);
+            std::swap(area_state_, rhs.area_state_);
+            std::swap(mode_, rhs.mode_);
+            std::locale const loc = this->getloc();
+            this->pubimbue(rhs.getloc());
+            rhs.pubimbue(loc);
+        }
+
+        ///
+        /// Same as std::basic_filebuf::open but s is UTF-8 string
         ///
         basic_filebuf *open(std::string const &s, std::ios_base::openmode mode)
         {
             return open(s.c_str(), mode);
         }
         ///
-        /// Same as std::filebuf::open but s is UTF-8 string
+        /// Same as std::basic_filebuf::open but s is UTF-8 string
         ///
         basic_filebuf *open(char const *s, std::ios_base::openmode mode)
         {
@@ -103,29 +2260,12 @@ namespace nowide {
         }
         basic_filebuf *open(wchar_t const *s, std::ios_base::openmode mode)
         {
-            if(is_open())
+            if(is_open() || !bytes_.open(s, mode))
                 return NULL;
-            validate_cvt(this->getloc());
-            bool const ate = bool(mode & std::ios_base::ate);
-            wchar_t const *smode = get_mode(mode);
-            if(!smode)
-                return 0;
-#ifdef BOOST_WINDOWS
-            file_ = ::_wfopen(s, smode);
-#else
-            stackstring const name(s);
-            short_stackstring smode2(smode);
-            file_ = std::fopen(name.c_str(), smode2.c_str());
-#endif
-
-            if(!file_)
-                return 0;
-            if(ate && std::fseek(file_, 0, SEEK_END) != 0)
-            {
-                close();
-                return 0;
-            }
             mode_ = mode;
+            buffer_ = new CharType[buffer_size_];
+            raw_ = new char[raw_size()];
+            reset();
             return this;
         }
 #ifdef BOOST_NOWIDE_USE_FILESYSTEM
@@ -135,305 +2275,258 @@ namespace nowide {
         }
 #endif
         ///
-        /// Same as std::filebuf::close()
+        /// Same as std::basic_filebuf::close()
         ///
         basic_filebuf *close()
         {
             if(!is_open())
                 return NULL;
-            bool res = sync() == 0;
-            if(std::fclose(file_) != 0)
+            bool res = !this->pptr() || (write_put_area() && unshift());
+            if(!bytes_.close())
                 res = false;
-            file_ = NULL;
             mode_ = std::ios_base::openmode(0);
-            if(owns_buffer_)
-            {
-                delete[] buffer_;
-                buffer_ = NULL;
-                owns_buffer_ = false;
-            }
+            reset();
+            delete[] buffer_;
+            delete[] raw_;
+            buffer_ = NULL;
+            raw_ = NULL;
             return res ? this : NULL;
         }
         ///
-        /// Same as std::filebuf::is_open()
+        /// Same as std::basic_filebuf::is_open()
         ///
         bool is_open() const
         {
-            return file_ != NULL;
+            return bytes_.is_open();
         }
 
-    private:
-        void make_buffer()
+    protected:
+        virtual int_type overflow(int_type c = Traits::eof())
         {
-            if(buffer_)
-                return;
-            if(buffer_size_ > 0)
+            if(!(mode_ & (std::ios_base::out | std::ios_base::app)) || !start_writing())
+                return Traits::eof();
+            if(this->pptr() && !write_put_area())
+                return Traits::eof();
+            this->setp(buffer_, buffer_ + buffer_size_);
+            if(!Traits::eq_int_type(c, Traits::eof()))
             {
-                buffer_ = new char[buffer_size_];
-                owns_buffer_ = true;
+                *this->pptr() = Traits::to_char_type(c);
+                this->pbump(1);
             }
-        }
-        void validate_cvt(const std::locale &loc)
-        {
-            if(!std::use_facet<std::codecvt<char, char, std::mbstate_t> >(loc).always_noconv())
-                throw std::runtime_error("Converting codecvts are not supported");
+            return Traits::not_eof(c);
         }
 
-    protected:
-        virtual std::streambuf *setbuf(char *s, std::streamsize n)
+        virtual int sync()
         {
-            assert(n >= 0);
-            // Maximum compatibility: Discard all local buffers and use user-provided values
-            // Users should call sync() before or better use it before any IO is done or any file is opened
-            setg(NULL, NULL, NULL);
-            setp(NULL, NULL);
-            if(owns_buffer_)
-                delete[] buffer_;
-            buffer_ = s;
-            buffer_size_ = (n >= 0) ? n : 0;
-            return this;
+            if(!is_open())
+                return 0;
+            if(this->pptr())
+                return write_put_area() && unshift() && bytes_.pubsync() == 0 ? 0 : -1;
+            return stop_reading() ? 0 : -1;
         }
 
-        virtual int overflow(int c = EOF)
+        virtual int_type underflow()
         {
-            if(!(mode_ & std::ios_base::out))
-                return EOF;
-
-            if(!stop_reading())
-                return EOF;
-
-            size_t n = pptr() - pbase();
-            if(n > 0)
+            if(!(mode_ & std::ios_base::in) || !start_reading())
+                return Traits::eof();
+            if(this->gptr() < this->egptr())
+                return Traits::to_int_type(*this->gptr());
+            for(;;)
             {
-                if(std::fwrite(pbase(), 1, n, file_) != n)
-                    return -1;
-                setp(buffer_, buffer_ + buffer_size_);
-                if(c != EOF)
+                if(raw_begin_ < raw_end_)
                 {
-                    *buffer_ = c;
-                    pbump(1);
+                    std::mbstate_t const start_state = state_;
+                    char const *from_next;
+                    CharType *to_next;
+                    cvt_type::convert_in(state_, raw_ + raw_begin_, raw_ + raw_end_, from_next, buffer_, buffer_ + buffer_size_, to_next);
+                    if(to_next != buffer_)
+                    {
+                        area_begin_ = raw_begin_;
+                        area_state_ = start_state;
+                        raw_begin_ = from_next - raw_;
+                        this->setg(buffer_, buffer_, to_next);
+                        return Traits::to_int_type(*this->gptr());
+                    }
+                    // Only an incomplete sequence is left
                 }
-            } else if(c != EOF)
-            {
-                if(buffer_size_ > 0)
-                {
-                    make_buffer();
-                    setp(buffer_, buffer_ + buffer_size_);
-                    *buffer_ = c;
-                    pbump(1);
-                } else if(std::fputc(c, file_) == EOF)
-                {
-                    return EOF;
-                } else if(!pptr())
+                size_t const left = raw_end_ - raw_begin_;
+                std::memmove(raw_, raw_ + raw_begin_, left);
+                raw_begin_ = area_begin_ = 0;
+                raw_end_ = left;
+                std::streamsize const n = bytes_.sgetn(raw_ + left, static_cast<std::streamsize>(raw_size() - left));
+                if(n > 0)
                 {
-                    // Set to dummy value so we know we have writting something
-                    setp(&last_char_, &last_char_);
+                    raw_end_ += static_cast<size_t>(n);
+                    continue;
                 }
+                this->setg(buffer_, buffer_, buffer_);
+                if(left == 0)
+                    return Traits::eof();
+                // The file ends with an incomplete sequence
+                raw_begin_ = raw_end_;
+                state_ = area_state_ = std::mbstate_t();
+                buffer_[0] = static_cast<CharType>(BOOST_NOWIDE_REPLACEMENT_CHARACTER);
+                this->setg(buffer_, buffer_, buffer_ + 1);
+                return Traits::to_int_type(*this->gptr());
             }
-            return Traits::not_eof(c);
-        }
-
-        virtual int sync()
-        {
-            if(!file_)
-                return 0;
-            bool result;
-            if(pptr())
-            {
-                result = overflow() != EOF;
-                // Only flush if anything was written, otherwise behavior of fflush is undefined
-                if(std::fflush(file_) != 0)
-                    return result = false;
-            } else
-                result = stop_reading();
-            return result ? 0 : -1;
         }
 
-        virtual int underflow()
+        virtual pos_type seekoff(off_type off,
+                                 std::ios_base::seekdir seekdir,
+                                 std::ios_base::openmode = std::ios_base::in | std::ios_base::out)
         {
-            if(!(mode_ & std::ios_base::in))
-                return EOF;
-            if(!stop_writing())
-                return EOF;
-            if(buffer_size_ == 0)
-            {
-                int const c = std::fgetc(file_);
-                if(c == EOF)
-                    return EOF;
-                last_char_ = c;
-                setg(&last_char_, &last_char_, &last_char_ + 1);
-            } else
-            {
-                make_buffer();
-                size_t const n = std::fread(buffer_, 1, buffer_size_, file_);
-                setg(buffer_, buffer_, buffer_ + n);
-                if(n == 0)
-                    return EOF;
-            }
-            return Traits::to_int_type(*gptr());
+            if(!is_open())
+                return pos_type(off_type(-1));
+            if(off == 0 && seekdir == std::ios_base::cur)
+                return position();
+            // Relative offsets in characters can't be mapped to bytes
+            if(off != 0 && seekdir != std::ios_base::beg)
+                return pos_type(off_type(-1));
+            if(sync() != 0)
+                return pos_type(off_type(-1));
+            this->setp(0, 0);
+            pos_type const res = bytes_.pubseekoff(off, seekdir);
+            // Nothing of the conversion before the seek belongs to the new position
+            if(res != pos_type(off_type(-1)))
+                state_ = area_state_ = std::mbstate_t();
+            return res;
         }
-
-        virtual int pbackfail(int c = EOF)
+        virtual pos_type seekpos(pos_type pos, std::ios_base::openmode m = std::ios_base::in | std::ios_base::out)
         {
-            if(!(mode_ & std::ios_base::in))
-                return EOF;
-            if(!stop_writing())
-                return EOF;
-            if(gptr() > eback())
-                gbump(-1);
-            else if(seekoff(-1, std::ios_base::cur) != std::streampos(std::streamoff(-1)))
-            {
-                if(underflow() == EOF)
-                    return EOF;
-            } else
-                return EOF;
-
-            // Case 1: Caller just wanted space for 1 char
-            if(c == EOF)
-                return Traits::not_eof(c);
-            // Case 2: Caller wants to put back different char
-            // gptr now points to the (potentially newly read) previous char
-            if(*gptr() != c)
-                *gptr() = Traits::to_char_type(c);
-            return Traits::not_eof(c);
+            return seekoff(off_type(pos), std::ios_base::beg, m);
         }
 
-        virtual std::streampos
-        seekoff(std::streamoff off, std::ios_base::seekdir seekdir, std::ios_base::openmode = std::ios_base::in | std::ios_base::out)
+    private:
+        size_t raw_size() const
         {
-            if(!file_)
-                return EOF;
-            // Switching between input<->output requires a seek
-            // So do NOT optimize for seekoff(0, cur) as No-OP
-
-            // On some implementations a seek also flushes, so do a full sync
-            if(sync() != 0)
-                return EOF;
-            int whence;
-            switch(seekdir)
-            {
-            case std::ios_base::beg: whence = SEEK_SET; break;
-            case std::ios_base::cur: whence = SEEK_CUR; break;
-            case std::ios_base::end: whence = SEEK_END; break;
-            default: assert(false); return EOF;
-            }
-            if(std::fseek(file_, off, whence) != 0)
-                return EOF;
-            return std::ftell(file_);
+            // Each character is encoded in at most 4 bytes, so a full put area always fits
+            return buffer_size_ * 4;
         }
-        virtual std::streampos seekpos(std::streampos pos, std::ios_base::openmode m = std::ios_base::in | std::ios_base::out)
+        void set_areas(CharType *eb, CharType *g, CharType *eg, CharType *pb, CharType *p, CharType *ep)
         {
-            // Standard mandates "as-if fsetpos", but assume the effect is the same as fseek
-            return seekoff(pos, std::ios_base::beg, m);
+            this->setg(eb, g, eg);
+            this->setp(pb, ep);
+            if(p)
+                this->pbump(static_cast<int>(p - pb));
         }
-        virtual void imbue(const std::locale &loc)
+        void reset()
         {
-            validate_cvt(loc);
+            raw_begin_ = raw_end_ = area_begin_ = 0;
+            state_ = area_state_ = std::mbstate_t();
+            this->setg(0, 0, 0);
+            this->setp(0, 0);
         }
 
-    private:
-        /// Stop reading adjusting the file pointer if neccessary
-        /// Postcondition: gptr() == NULL
-        bool stop_reading()
+        /// Convert and write the put area. Postcondition: pptr() == pbase()
+        bool write_put_area()
         {
-            if(gptr())
+            CharType const *from = this->pbase();
+            CharType const *const from_end = this->pptr();
+            this->setp(this->pbase(), this->epptr());
+            while(from != from_end)
             {
-                std::streamsize const off = gptr() - egptr();
-                setg(0, 0, 0);
-                assert(off <= std::numeric_limits<long>::max());
-                if(off && std::fseek(file_, off, SEEK_CUR) != 0)
+                CharType const *from_next;
+                char *to_next;
+                if(cvt_type::convert_out(state_, from, from_end, from_next, raw_, raw_ + raw_size(), to_next)
+                   == std::codecvt_base::error)
+                    return false;
+                std::streamsize const n = to_next - raw_;
+                if(bytes_.sputn(raw_, n) != n)
                     return false;
+                from = from_next;
             }
             return true;
         }
-
-        /// Stop writing. If any bytes are to be written, writes them to file
-        /// Postcondition: pptr() == NULL
-        bool stop_writing()
+        /// Finish the conversion of the written characters. Fails if they end with an incomplete sequence, i.e.
+        /// a high surrogate without the low one
+        bool unshift()
         {
-            if(pptr())
-            {
-                const char *const base = pbase();
-                size_t const n = pptr() - base;
-                setp(0, 0);
-                if(n && std::fwrite(base, 1, n, file_) != n)
-                    return false;
-            }
-            return true;
+            cvt_type const cvt(1);
+            char *to_next;
+            std::codecvt_base::result const r = cvt.unshift(state_, raw_, raw_ + raw_size(), to_next);
+            if(r == std::codecvt_base::noconv)
+                return true;
+            if(r != std::codecvt_base::ok)
+                return false;
+            std::streamsize const n = to_next - raw_;
+            return bytes_.sputn(raw_, n) == n;
         }
 
-        void reset(FILE *f = 0)
+        /// Position of gptr() in the file
+        pos_type position()
         {
-            sync();
-            if(file_)
+            if(this->pptr())
             {
-                fclose(file_);
-                file_ = 0;
+                if(!write_put_area())
+                    return pos_type(off_type(-1));
+                return bytes_.pubseekoff(0, std::ios_base::cur);
+            }
+            pos_type const pos = bytes_.pubseekoff(0, std::ios_base::cur);
+            if(pos == pos_type(off_type(-1)))
+                return pos;
+            // The position of the first byte of the get area...
+            off_type res = off_type(pos) - static_cast<off_type>(raw_end_ - area_begin_);
+            // ...plus the bytes of the consumed characters
+            if(this->gptr() == this->egptr())
+                res += static_cast<off_type>(raw_begin_ - area_begin_);
+            else if(this->gptr() != this->eback())
+            {
+                // Convert the consumed part once more to find out how many bytes it took.
+                // This writes the same characters again, so the get area doesn't change.
+                std::mbstate_t state = area_state_;
+                char const *from_next;
+                CharType *to_next;
+                cvt_type::convert_in(state, raw_ + area_begin_, raw_ + raw_begin_, from_next, this->eback(), this->gptr(), to_next);
+                res += static_cast<off_type>(from_next - (raw_ + area_begin_));
             }
-            file_ = f;
+            return pos_type(res);
         }
 
-        static wchar_t const *get_mode(std::ios_base::openmode mode)
+        bool start_reading()
         {
-            // Flag out ate
-            mode = static_cast<std::ios_base::openmode>(static_cast<unsigned>(mode) & ~static_cast<unsigned>(std::ios_base::ate));
-            //
-            // done according to n2914 table 106 27.9.1.4
-            //
-
-            // note can't use switch case as overload operator can't be used
-            // in constant expression
-            if(mode == (std::ios_base::out))
-                return L"w";
-            if(mode == (std::ios_base::out | std::ios_base::app))
-                return L"a";
-            if(mode == (std::ios_base::app))
-                return L"a";
-            if(mode == (std::ios_base::out | std::ios_base::trunc))
-                return L"w";
-            if(mode == (std::ios_base::in))
-                return L"r";
-            if(mode == (std::ios_base::in | std::ios_base::out))
-                return L"r+";
-            if(mode == (std::ios_base::in | std::ios_base::out | std::ios_base::trunc))
-                return L"w+";
-            if(mode == (std::ios_base::in | std::ios_base::out | std::ios_base::app))
-                return L"a+";
-            if(mode == (std::ios_base::in | std::ios_base::app))
-                return L"a+";
-            if(mode == (std::ios_base::binary | std::ios_base::out))
-                return L"wb";
-            if(mode == (std::ios_base::binary | std::ios_base::out | std::ios_base::app))
-                return L"ab";
-            if(mode == (std::ios_base::binary | std::ios_base::app))
-                return L"ab";
-            if(mode == (std::ios_base::binary | std::ios_base::out | std::ios_base::trunc))
-                return L"wb";
-            if(mode == (std::ios_base::binary | std::ios_base::in))
-                return L"rb";
-            if(mode == (std::ios_base::binary | std::ios_base::in | std::ios_base::out))
-                return L"r+b";
-            if(mode == (std::ios_base::binary | std::ios_base::in | std::ios_base::out | std::ios_base::trunc))
-                return L"w+b";
-            if(mode == (std::ios_base::binary | std::ios_base::in | std::ios_base::out | std::ios_base::app))
-                return L"a+b";
-            if(mode == (std::ios_base::binary | std::ios_base::in | std::ios_base::app))
-                return L"a+b";
-            return 0;
+            if(!this->pptr())
+                return true;
+            bool const res = write_put_area() && unshift();
+            this->setp(0, 0);
+            // The state is used for reading now
+            state_ = std::mbstate_t();
+            return res;
+        }
+        bool start_writing()
+        {
+            return stop_reading();
+        }
+        /// Discard the get area and move the file to the position of gptr()
+        bool stop_reading()
+        {
+            if(!this->gptr() && raw_begin_ == raw_end_)
+                return true;
+            pos_type const pos = position();
+            raw_begin_ = raw_end_ = area_begin_ = 0;
+            state_ = area_state_ = std::mbstate_t();
+            this->setg(0, 0, 0);
+            return pos != pos_type(off_type(-1)) && bytes_.pubseekpos(pos) == pos;
         }
 
+        basic_filebuf<char> bytes_;
         size_t buffer_size_;
-        char *buffer_;
-        FILE *file_;
-        bool owns_buffer_;
-        char last_char_;
+        /// Get or put area
+        CharType *buffer_;
+        /// UTF-8 bytes, [raw_begin_, raw_end_) are not yet converted, [area_begin_, raw_begin_) are in the get area
+        char *raw_;
+        size_t raw_begin_;
+        size_t raw_end_;
+        size_t area_begin_;
+        std::mbstate_t state_;
+        /// Conversion state at area_begin_
+        std::mbstate_t area_state_;
         std::ios::openmode mode_;
     };
 
     ///
     /// \brief Convenience typedef
     ///
-    typedef basic_filebuf<char> filebuf;
+    typedef basic_filebuf<wchar_t> wfilebuf;
 
 #endif // windows
 
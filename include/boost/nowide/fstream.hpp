@@ -10,10 +10,15 @@
 
 #include <boost/nowide/config.hpp>
 #include <boost/nowide/filebuf.hpp>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <vector>
 #if BOOST_NOWIDE_USE_WIN_FSTREAM
 #include <iosfwd>
 #include <streambuf>
 #include <cstdio>
+#include <utility>
 #ifdef BOOST_NOWIDE_USE_FILESYSTEM
 #include <boost/filesystem/path.hpp>
 #endif
@@ -44,6 +49,91 @@ namespace nowide {
     using BOOST_NOWIDE_FS_NS::ifstream;
     using BOOST_NOWIDE_FS_NS::ofstream;
     using BOOST_NOWIDE_FS_NS::fstream;
+
+    ///
+    /// \brief Same as std::wifstream but always reads UTF-8
+    ///
+    class wifstream : public BOOST_NOWIDE_FS_NS::wifstream
+    {
+    public:
+        wifstream()
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+        }
+        explicit wifstream(char const *file_name, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+            this->open(file_name, mode);
+        }
+        explicit wifstream(std::string const &file_name, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+            this->open(file_name.c_str(), mode);
+        }
+#ifdef BOOST_NOWIDE_USE_FILESYSTEM
+        explicit wifstream(boost::filesystem::path const &file_path, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+            this->open(file_path, mode);
+        }
+#endif
+    };
+    ///
+    /// \brief Same as std::wofstream but always writes UTF-8
+    ///
+    class wofstream : public BOOST_NOWIDE_FS_NS::wofstream
+    {
+    public:
+        wofstream()
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+        }
+        explicit wofstream(char const *file_name, std::ios_base::openmode mode = std::ios_base::out)
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+            this->open(file_name, mode);
+        }
+        explicit wofstream(std::string const &file_name, std::ios_base::openmode mode = std::ios_base::out)
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+            this->open(file_name.c_str(), mode);
+        }
+#ifdef BOOST_NOWIDE_USE_FILESYSTEM
+        explicit wofstream(boost::filesystem::path const &file_path, std::ios_base::openmode mode = std::ios_base::out)
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+            this->open(file_path, mode);
+        }
+#endif
+    };
+    ///
+    /// \brief Same as std::wfstream but always reads and writes UTF-8
+    ///
+    class wfstream : public BOOST_NOWIDE_FS_NS::wfstream
+    {
+    public:
+        wfstream()
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+        }
+        explicit wfstream(char const *file_name, std::ios_base::openmode mode = std::ios_base::in | std::ios_base::out)
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+            this->open(file_name, mode);
+        }
+        explicit wfstream(std::string const &file_name, std::ios_base::openmode mode = std::ios_base::in | std::ios_base::out)
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+            this->open(file_name.c_str(), mode);
+        }
+#ifdef BOOST_NOWIDE_USE_FILESYSTEM
+        explicit wfstream(boost::filesystem::path const &file_path, std::ios_base::openmode mode = std::ios_base::in | std::ios_base::out)
+        {
+            this->imbue(details::utf8_wide_locale(this->getloc()));
+            this->open(file_path, mode);
+        }
+#endif
+    };
 #undef BOOST_NOWIDE_FS_NS
 
 #else
@@ -120,10 +210,36 @@ namespace nowide {
             return const_cast<internal_buffer_type *>(&buf_);
         }
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+        basic_ifstream(basic_ifstream &&other) : internal_stream_type(std::move(other)), buf_(std::move(other.buf_))
+        {
+            this->set_rdbuf(&buf_);
+        }
+        basic_ifstream &operator=(basic_ifstream &&other)
+        {
+            internal_stream_type::operator=(std::move(other));
+            buf_ = std::move(other.buf_);
+            return *this;
+        }
+        void swap(basic_ifstream &other)
+        {
+            internal_stream_type::swap(other);
+            buf_.swap(other.buf_);
+        }
+#endif
+
     private:
         internal_buffer_type buf_;
     };
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+    template<typename CharType, typename Traits>
+    void swap(basic_ifstream<CharType, Traits> &lhs, basic_ifstream<CharType, Traits> &rhs)
+    {
+        lhs.swap(rhs);
+    }
+#endif
+
     ///
     /// \brief Same as std::basic_ofstream<char> but accepts UTF-8 strings under Windows
     ///
@@ -198,10 +314,62 @@ namespace nowide {
             return const_cast<internal_buffer_type *>(&buf_);
         }
 
+        ///
+        /// Write the count buffers in order like write() does for a single one, see basic_filebuf<char>::write_iov.
+        /// Sets badbit if not everything could be written
+        ///
+        basic_ofstream &write_iov(io_buffer const *buffers, size_t count)
+        {
+            typename internal_stream_type::sentry const guard(*this);
+            if(guard)
+            {
+                std::streamsize total = 0;
+                for(size_t i = 0; i < count; i++)
+                    total += static_cast<std::streamsize>(buffers[i].size);
+                if(buf_.write_iov(buffers, count) != total)
+                    this->setstate(std::ios_base::badbit);
+            }
+            return *this;
+        }
+
+        ///
+        /// Preallocate disk space for a file of size bytes, see basic_filebuf<char>::reserve
+        ///
+        bool reserve(std::streamoff size)
+        {
+            return buf_.reserve(size);
+        }
+
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+        basic_ofstream(basic_ofstream &&other) : internal_stream_type(std::move(other)), buf_(std::move(other.buf_))
+        {
+            this->set_rdbuf(&buf_);
+        }
+        basic_ofstream &operator=(basic_ofstream &&other)
+        {
+            internal_stream_type::operator=(std::move(other));
+            buf_ = std::move(other.buf_);
+            return *this;
+        }
+        void swap(basic_ofstream &other)
+        {
+            internal_stream_type::swap(other);
+            buf_.swap(other.buf_);
+        }
+#endif
+
     private:
         internal_buffer_type buf_;
     };
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+    template<typename CharType, typename Traits>
+    void swap(basic_ofstream<CharType, Traits> &lhs, basic_ofstream<CharType, Traits> &rhs)
+    {
+        lhs.swap(rhs);
+    }
+#endif
+
     ///
     /// \brief Same as std::basic_fstream<char> but accepts UTF-8 strings under Windows
     ///
@@ -277,10 +445,62 @@ namespace nowide {
             return const_cast<internal_buffer_type *>(&buf_);
         }
 
+        ///
+        /// Write the count buffers in order like write() does for a single one, see basic_filebuf<char>::write_iov.
+        /// Sets badbit if not everything could be written
+        ///
+        basic_fstream &write_iov(io_buffer const *buffers, size_t count)
+        {
+            typename std::basic_ostream<CharType, Traits>::sentry const guard(*this);
+            if(guard)
+            {
+                std::streamsize total = 0;
+                for(size_t i = 0; i < count; i++)
+                    total += static_cast<std::streamsize>(buffers[i].size);
+                if(buf_.write_iov(buffers, count) != total)
+                    this->setstate(std::ios_base::badbit);
+            }
+            return *this;
+        }
+
+        ///
+        /// Preallocate disk space for a file of size bytes, see basic_filebuf<char>::reserve
+        ///
+        bool reserve(std::streamoff size)
+        {
+            return buf_.reserve(size);
+        }
+
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+        basic_fstream(basic_fstream &&other) : internal_stream_type(std::move(other)), buf_(std::move(other.buf_))
+        {
+            this->set_rdbuf(&buf_);
+        }
+        basic_fstream &operator=(basic_fstream &&other)
+        {
+            internal_stream_type::operator=(std::move(other));
+            buf_ = std::move(other.buf_);
+            return *this;
+        }
+        void swap(basic_fstream &other)
+        {
+            internal_stream_type::swap(other);
+            buf_.swap(other.buf_);
+        }
+#endif
+
     private:
         internal_buffer_type buf_;
     };
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+    template<typename CharType, typename Traits>
+    void swap(basic_fstream<CharType, Traits> &lhs, basic_fstream<CharType, Traits> &rhs)
+    {
+        lhs.swap(rhs);
+    }
+#endif
+
     ///
     /// \brief Same as std::filebuf but accepts UTF-8 strings under Windows
     ///
@@ -298,7 +518,84 @@ namespace nowide {
     ///
     typedef basic_fstream<char> fstream;
 
+    ///
+    /// \brief Same as std::wfilebuf but accepts UTF-8 strings under Windows and always reads and writes UTF-8
+    ///
+    typedef basic_filebuf<wchar_t> wfilebuf;
+    ///
+    /// Same as std::wifstream but accepts UTF-8 strings under Windows and always reads UTF-8
+    ///
+    typedef basic_ifstream<wchar_t> wifstream;
+    ///
+    /// Same as std::wofstream but accepts UTF-8 strings under Windows and always writes UTF-8
+    ///
+    typedef basic_ofstream<wchar_t> wofstream;
+    ///
+    /// Same as std::wfstream but accepts UTF-8 strings under Windows and always reads and writes UTF-8
+    ///
+    typedef basic_fstream<wchar_t> wfstream;
+
 #endif
+
+    ///
+    /// \brief Copy up to n bytes from the current position of in to out and return the number of bytes copied
+    ///
+    /// If both streams use a boost::nowide::filebuf, basic_filebuf<char>::transfer is used which lets the kernel copy
+    /// the data where possible. Otherwise the data is copied through a buffer.
+    ///
+    /// If fewer than n bytes were copied, sets eofbit of in if its end was reached, badbit of out if writing failed
+    /// and badbit of in if reading failed otherwise.
+    ///
+    inline std::streamsize transfer(std::istream &in, std::ostream &out, std::streamsize n)
+    {
+        std::istream::sentry const in_guard(in, true);
+        std::ostream::sentry const out_guard(out);
+        if(!in_guard || !out_guard || n <= 0)
+            return 0;
+        std::streamsize res = 0;
+        bool write_failed = false;
+#if BOOST_NOWIDE_USE_WIN_FSTREAM
+        filebuf *const src = dynamic_cast<filebuf *>(in.rdbuf());
+        filebuf *const dst = dynamic_cast<filebuf *>(out.rdbuf());
+        if(src && dst)
+        {
+            res = src->transfer(*dst, n);
+            // The input is only left with data if writing it failed
+            write_failed =
+              res < n && !std::istream::traits_type::eq_int_type(src->sgetc(), std::istream::traits_type::eof());
+        } else
+#endif
+        {
+            std::vector<char> buf(static_cast<size_t>(std::min<std::streamsize>(n, 64 * 1024)));
+            while(res < n)
+            {
+                std::streamsize const request = std::min<std::streamsize>(n - res, static_cast<std::streamsize>(buf.size()));
+                std::streamsize const k = in.rdbuf()->sgetn(&buf[0], request);
+                if(k > 0)
+                {
+                    std::streamsize const written = out.rdbuf()->sputn(&buf[0], k);
+                    res += written;
+                    if(written != k)
+                    {
+                        write_failed = true;
+                        break;
+                    }
+                }
+                if(k != request)
+                    break;
+            }
+        }
+        if(res < n)
+        {
+            if(write_failed)
+                out.setstate(std::ios_base::badbit);
+            else if(std::istream::traits_type::eq_int_type(in.rdbuf()->sgetc(), std::istream::traits_type::eof()))
+                in.setstate(std::ios_base::eofbit);
+            else
+                in.setstate(std::ios_base::badbit);
+        }
+        return res;
+    }
 } // namespace nowide
 } // namespace boost
 
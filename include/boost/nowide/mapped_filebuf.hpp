@@ -0,0 +1,456 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef BOOST_NOWIDE_MAPPED_FILEBUF_HPP_INCLUDED
+#define BOOST_NOWIDE_MAPPED_FILEBUF_HPP_INCLUDED
+
+#include <boost/nowide/config.hpp>
+#include <boost/nowide/stackstring.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <ios>
+#include <istream>
+#include <streambuf>
+#include <string>
+#ifndef BOOST_WINDOWS
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef BOOST_NOWIDE_USE_FILESYSTEM
+#include <boost/filesystem/path.hpp>
+#endif
+
+#ifdef BOOST_MSVC
+#pragma warning(push)
+#pragma warning(disable : 4251)
+#endif
+
+namespace boost {
+namespace nowide {
+
+    /// \cond INTERNAL
+    namespace details {
+        ///
+        /// \brief Read-only file which can map windows of its content into memory
+        ///
+        /// Only one window is mapped at a time, mapping a new one unmaps the previous
+        ///
+        class BOOST_NOWIDE_DECL mapped_file
+        {
+            // Non-copyable
+            mapped_file(const mapped_file &);
+            mapped_file &operator=(const mapped_file &);
+
+        public:
+            mapped_file();
+            ~mapped_file();
+            bool is_open() const;
+            bool open(wchar_t const *name);
+            bool close();
+            /// Size of the file at the time it was opened
+            std::streamoff size() const
+            {
+                return size_;
+            }
+            /// Offsets passed to map() must be a multiple of this
+            static size_t granularity();
+            /// Map n bytes starting at offset, returns NULL on failure
+            char const *map(std::streamoff offset, size_t n);
+            void unmap();
+
+        private:
+#ifdef BOOST_WINDOWS
+            void *file_;
+            void *mapping_;
+#else
+            int fd_;
+#endif
+            std::streamoff size_;
+            void *view_;
+            size_t view_size_;
+        };
+
+#ifndef BOOST_WINDOWS
+        inline mapped_file::mapped_file() : fd_(-1), size_(0), view_(0), view_size_(0)
+        {}
+        inline mapped_file::~mapped_file()
+        {
+            close();
+        }
+        inline bool mapped_file::is_open() const
+        {
+            return fd_ != -1;
+        }
+        inline bool mapped_file::open(wchar_t const *name)
+        {
+            if(is_open())
+                return false;
+            stackstring const name2(name);
+            do
+            {
+                fd_ = ::open(name2.c_str(), O_RDONLY);
+            } while(fd_ == -1 && errno == EINTR);
+            if(fd_ == -1)
+                return false;
+            struct stat st;
+            if(::fstat(fd_, &st) != 0 || !S_ISREG(st.st_mode))
+            {
+                close();
+                return false;
+            }
+            size_ = st.st_size;
+            return true;
+        }
+        inline bool mapped_file::close()
+        {
+            if(fd_ == -1)
+                return true;
+            unmap();
+            bool const res = ::close(fd_) == 0;
+            fd_ = -1;
+            size_ = 0;
+            return res;
+        }
+        inline size_t mapped_file::granularity()
+        {
+            static const long page_size = ::sysconf(_SC_PAGESIZE);
+            return page_size > 0 ? static_cast<size_t>(page_size) : 4096u;
+        }
+        inline char const *mapped_file::map(std::streamoff offset, size_t n)
+        {
+            assert(offset % granularity() == 0);
+            unmap();
+            void *const p = ::mmap(0, n, PROT_READ, MAP_SHARED, fd_, static_cast<off_t>(offset));
+            if(p == MAP_FAILED)
+                return 0;
+            view_ = p;
+            view_size_ = n;
+            return static_cast<char const *>(p);
+        }
+        inline void mapped_file::unmap()
+        {
+            if(view_)
+            {
+                ::munmap(view_, view_size_);
+                view_ = 0;
+                view_size_ = 0;
+            }
+        }
+#endif
+    } // namespace details
+    /// \endcond
+
+    ///
+    /// \brief Read-only stream buffer which maps the file into memory
+    ///
+    /// The get area points directly into the mapping so no data is copied into an intermediate buffer.
+    /// Only a window of window_size() bytes is mapped at a time, so files larger than the address space can be read.
+    /// Reaching the end of the window or seeking outside of it maps the next window.
+    ///
+    /// The file is expected to not change while it is open. Only regular files can be opened.
+    ///
+    class mapped_filebuf : public std::streambuf
+    {
+        // Non-copyable
+        mapped_filebuf(const mapped_filebuf &);
+        mapped_filebuf &operator=(const mapped_filebuf &);
+
+        typedef std::char_traits<char> Traits;
+
+    public:
+        ///
+        /// Creates new mapped_filebuf
+        ///
+        mapped_filebuf() : window_size_(default_window_size), window_start_(0)
+        {
+            setg(0, 0, 0);
+        }
+
+        virtual ~mapped_filebuf()
+        {
+            close();
+        }
+
+        ///
+        /// Same as std::filebuf::open but s is UTF-8 string. Fails if mode contains out
+        ///
+        mapped_filebuf *open(std::string const &s, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            return open(s.c_str(), mode);
+        }
+        ///
+        /// Same as std::filebuf::open but s is UTF-8 string. Fails if mode contains out
+        ///
+        mapped_filebuf *open(char const *s, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            wstackstring const name(s);
+            return open(name.c_str(), mode);
+        }
+        mapped_filebuf *open(wchar_t const *s, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            if(is_open() || (mode & (std::ios_base::out | std::ios_base::app | std::ios_base::trunc)))
+                return NULL;
+            if(!file_.open(s))
+                return NULL;
+            window_start_ = (mode & std::ios_base::ate) ? file_.size() : 0;
+            return this;
+        }
+#ifdef BOOST_NOWIDE_USE_FILESYSTEM
+        mapped_filebuf *open(boost::filesystem::path const &s, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            return open(s.c_str(), mode);
+        }
+#endif
+        ///
+        /// Same as std::filebuf::close()
+        ///
+        mapped_filebuf *close()
+        {
+            if(!is_open())
+                return NULL;
+            setg(0, 0, 0);
+            window_start_ = 0;
+            return file_.close() ? this : NULL;
+        }
+        ///
+        /// Same as std::filebuf::is_open()
+        ///
+        bool is_open() const
+        {
+            return file_.is_open();
+        }
+        ///
+        /// Size of the file in bytes
+        ///
+        std::streamoff size() const
+        {
+            return file_.size();
+        }
+        ///
+        /// Set the maximum number of bytes mapped at once. Rounded up to the mapping granularity.
+        /// Takes effect when the next window is mapped.
+        ///
+        void window_size(size_t n)
+        {
+            size_t const g = details::mapped_file::granularity();
+            window_size_ = std::max<size_t>((n + g - 1) / g, 1) * g;
+        }
+        ///
+        /// Get the maximum number of bytes mapped at once
+        ///
+        size_t window_size() const
+        {
+            return window_size_;
+        }
+
+        /// Default window size, big enough to make remapping costs negligible
+        /// while staying well inside a 32 bit address space
+        static const size_t default_window_size = 64 * 1024 * 1024;
+
+    protected:
+        virtual int underflow()
+        {
+            if(!is_open())
+                return EOF;
+            if(gptr() < egptr())
+                return Traits::to_int_type(*gptr());
+            if(!map_window(position()))
+                return EOF;
+            return Traits::to_int_type(*gptr());
+        }
+
+        virtual std::streamsize showmanyc()
+        {
+            if(!is_open())
+                return -1;
+            std::streamoff const remaining = file_.size() - position();
+            return remaining > 0 ? static_cast<std::streamsize>(remaining) : -1;
+        }
+
+        virtual int pbackfail(int c = EOF)
+        {
+            if(!is_open())
+                return EOF;
+            if(gptr() == eback())
+            {
+                std::streamoff const pos = position();
+                if(pos == 0)
+                    return EOF;
+                // Map a window containing the previous char
+                if(!map_window(pos - 1))
+                    return EOF;
+            } else
+                gbump(-1);
+            // The mapping is read-only so a different char can't be put back
+            if(c != EOF && *gptr() != Traits::to_char_type(c))
+            {
+                gbump(1);
+                return EOF;
+            }
+            return Traits::not_eof(c);
+        }
+
+        virtual std::streampos
+        seekoff(std::streamoff off, std::ios_base::seekdir seekdir, std::ios_base::openmode = std::ios_base::in | std::ios_base::out)
+        {
+            if(!is_open())
+                return EOF;
+            std::streamoff target;
+            switch(seekdir)
+            {
+            case std::ios_base::beg: target = off; break;
+            case std::ios_base::cur: target = position() + off; break;
+            case std::ios_base::end: target = file_.size() + off; break;
+            default: assert(false); return EOF;
+            }
+            if(target < 0)
+                return EOF;
+            if(eback() && target >= window_start_ && target <= window_start_ + (egptr() - eback()))
+            {
+                // Inside the current window: Just move the read pointer
+                setg(eback(), eback() + static_cast<size_t>(target - window_start_), egptr());
+            } else
+            {
+                // Map lazily on the next read
+                file_.unmap();
+                setg(0, 0, 0);
+                window_start_ = target;
+            }
+            return target;
+        }
+        virtual std::streampos seekpos(std::streampos pos, std::ios_base::openmode m = std::ios_base::in | std::ios_base::out)
+        {
+            return seekoff(pos, std::ios_base::beg, m);
+        }
+
+    private:
+        /// Offset in the file of the next char to read
+        std::streamoff position() const
+        {
+            return window_start_ + (gptr() - eback());
+        }
+
+        /// Map the window containing pos and set the get area to start at pos
+        bool map_window(std::streamoff pos)
+        {
+            if(pos >= file_.size())
+                return false;
+            std::streamoff const start = pos - pos % static_cast<std::streamoff>(details::mapped_file::granularity());
+            size_t const n = static_cast<size_t>(std::min<std::streamoff>(window_size_, file_.size() - start));
+            char const *const data = file_.map(start, n);
+            if(!data)
+            {
+                setg(0, 0, 0);
+                window_start_ = pos;
+                return false;
+            }
+            // The get area is never written to as putback of different chars is rejected
+            char *const p = const_cast<char *>(data);
+            setg(p, p + static_cast<size_t>(pos - start), p + n);
+            window_start_ = start;
+            return true;
+        }
+
+        details::mapped_file file_;
+        size_t window_size_;
+        /// Offset in the file of eback() or the current position if nothing is mapped
+        std::streamoff window_start_;
+    };
+
+    ///
+    /// \brief Input stream reading a file through a mapped_filebuf
+    ///
+    class mapped_ifstream : public std::istream
+    {
+    public:
+        typedef mapped_filebuf internal_buffer_type;
+        typedef std::istream internal_stream_type;
+
+        mapped_ifstream() : internal_stream_type(NULL)
+        {
+            this->init(&buf_);
+        }
+
+        explicit mapped_ifstream(char const *file_name, std::ios_base::openmode mode = std::ios_base::in) :
+            internal_stream_type(NULL)
+        {
+            this->init(&buf_);
+            open(file_name, mode);
+        }
+
+        explicit mapped_ifstream(std::string const &file_name, std::ios_base::openmode mode = std::ios_base::in) :
+            internal_stream_type(NULL)
+        {
+            this->init(&buf_);
+            open(file_name, mode);
+        }
+
+        void open(wchar_t const *file_name, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            if(!buf_.open(file_name, mode | std::ios_base::in))
+                this->setstate(std::ios_base::failbit);
+            else
+                this->clear();
+        }
+#ifdef BOOST_NOWIDE_USE_FILESYSTEM
+        explicit mapped_ifstream(boost::filesystem::path const &file_path, std::ios_base::openmode mode = std::ios_base::in) :
+            internal_stream_type(NULL)
+        {
+            this->init(&buf_);
+            open(file_path, mode);
+        }
+        void open(boost::filesystem::path const &file_path, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            open(file_path.c_str(), mode);
+        }
+#endif
+
+        void open(std::string const &file_name, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            open(file_name.c_str(), mode);
+        }
+        void open(char const *file_name, std::ios_base::openmode mode = std::ios_base::in)
+        {
+            if(!buf_.open(file_name, mode | std::ios_base::in))
+                this->setstate(std::ios_base::failbit);
+            else
+                this->clear();
+        }
+        bool is_open() const
+        {
+            return buf_.is_open();
+        }
+        void close()
+        {
+            if(!buf_.close())
+                this->setstate(std::ios_base::failbit);
+        }
+
+        internal_buffer_type *rdbuf() const
+        {
+            return const_cast<internal_buffer_type *>(&buf_);
+        }
+
+    private:
+        internal_buffer_type buf_;
+    };
+
+} // namespace nowide
+} // namespace boost
+
+#ifdef BOOST_MSVC
+#pragma warning(pop)
+#endif
+
+#endif
+
+// vim: tabstop=4 expandtab shiftwidth=4 softtabstop=4
@@ -0,0 +1,527 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#ifndef BOOST_NOWIDE_UTF16_CODECVT_HPP
+#define BOOST_NOWIDE_UTF16_CODECVT_HPP
+
+#include <boost/nowide/utf8_codecvt.hpp>
+#include <boost/locale/utf.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/nowide/replacement.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <locale>
+
+namespace boost {
+namespace nowide {
+
+    ///
+    /// \brief Byte order of the external UTF-16 encoding used by utf16_codecvt
+    ///
+    enum utf16_byte_order
+    {
+        utf16_le, ///< UTF-16LE, the encoding of "Unicode" text files on Windows
+        utf16_be  ///< UTF-16BE
+    };
+
+    /// \cond INTERNAL
+    namespace details {
+        template<utf16_byte_order ByteOrder>
+        inline boost::uint16_t read_utf16_unit(char const *p)
+        {
+            boost::uint16_t const b0 = static_cast<unsigned char>(p[0]);
+            boost::uint16_t const b1 = static_cast<unsigned char>(p[1]);
+            return static_cast<boost::uint16_t>(ByteOrder == utf16_le ? (b0 | (b1 << 8)) : ((b0 << 8) | b1));
+        }
+        template<utf16_byte_order ByteOrder>
+        inline char *write_utf16_unit(boost::uint32_t u, char *p)
+        {
+            char const lo = static_cast<char>(u & 0xFF);
+            char const hi = static_cast<char>((u >> 8) & 0xFF);
+            *p++ = ByteOrder == utf16_le ? lo : hi;
+            *p++ = ByteOrder == utf16_le ? hi : lo;
+            return p;
+        }
+        inline bool is_surrogate(boost::uint32_t u)
+        {
+            return 0xD800 <= u && u <= 0xDFFF;
+        }
+        inline bool is_high_surrogate(boost::uint32_t u)
+        {
+            return 0xD800 <= u && u <= 0xDBFF;
+        }
+        inline bool is_low_surrogate(boost::uint32_t u)
+        {
+            return 0xDC00 <= u && u <= 0xDFFF;
+        }
+
+        ///
+        /// Convert the longest prefix of at most \a n UTF-16 units, which are not surrogates, from bytes at \a from to \a to
+        /// and return the number of converted units.
+        ///
+        template<utf16_byte_order ByteOrder, typename CharOut>
+        inline size_t read_bmp_units(char const *from, CharOut *to, size_t n)
+        {
+            size_t i = 0;
+            for(; i + ascii_block_size <= n; i += ascii_block_size)
+            {
+                bool has_surrogate = false;
+                for(size_t j = 0; j < ascii_block_size; j++)
+                    has_surrogate |= is_surrogate(read_utf16_unit<ByteOrder>(from + 2 * (i + j)));
+                if(has_surrogate)
+                    break;
+                for(size_t j = 0; j < ascii_block_size; j++)
+                    to[i + j] = static_cast<CharOut>(read_utf16_unit<ByteOrder>(from + 2 * (i + j)));
+            }
+            for(; i < n; i++)
+            {
+                boost::uint16_t const u = read_utf16_unit<ByteOrder>(from + 2 * i);
+                if(is_surrogate(u))
+                    break;
+                to[i] = static_cast<CharOut>(u);
+            }
+            return i;
+        }
+
+        ///
+        /// Convert the longest prefix of at most \a n characters, which are valid code points below 0x10000 and not surrogates,
+        /// from \a from to UTF-16 bytes at \a to and return the number of converted characters
+        ///
+        template<utf16_byte_order ByteOrder, typename CharIn>
+        inline size_t write_bmp_units(CharIn const *from, char *to, size_t n)
+        {
+            size_t i = 0;
+            for(; i + ascii_block_size <= n; i += ascii_block_size)
+            {
+                bool has_special = false;
+                for(size_t j = 0; j < ascii_block_size; j++)
+                {
+                    boost::uint32_t const c = code_unit(from[i + j]);
+                    has_special |= c > 0xFFFF || is_surrogate(c);
+                }
+                if(has_special)
+                    break;
+                for(size_t j = 0; j < ascii_block_size; j++)
+                    write_utf16_unit<ByteOrder>(code_unit(from[i + j]), to + 2 * (i + j));
+            }
+            for(; i < n; i++)
+            {
+                boost::uint32_t const c = code_unit(from[i]);
+                if(c > 0xFFFF || is_surrogate(c))
+                    break;
+                write_utf16_unit<ByteOrder>(c, to + 2 * i);
+            }
+            return i;
+        }
+
+        ///
+        /// Implements do_length via the conversion function \a Cvt::convert_in, so both are always consistent
+        ///
+        template<typename Cvt>
+        inline int utf16_length(std::mbstate_t &state, char const *from, char const *from_end, size_t max)
+        {
+            typename Cvt::uchar buf[64];
+            char const *const start = from;
+            size_t const save_max = max;
+            while(max > 0 && from < from_end)
+            {
+                typename Cvt::uchar *to_next;
+                char const *from_next;
+                size_t const n = std::min<size_t>(max, sizeof(buf) / sizeof(buf[0]));
+                Cvt::convert_in(state, from, from_end, from_next, buf, buf + n, to_next);
+                if(to_next == buf)
+                    break;
+                max -= to_next - buf;
+                from = from_next;
+            }
+#ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+            (void)save_max;
+            return static_cast<int>(from - start);
+#else
+            (void)start;
+            return static_cast<int>(save_max - max);
+#endif
+        }
+    } // namespace details
+    /// \endcond
+
+    ///
+    /// \brief Facet converting between a UTF-16LE or UTF-16BE byte stream and wide characters
+    ///
+    /// The external encoding consists of bytes in UTF-16 with the given byte order, the internal one is UTF-16
+    /// or UTF-32, depending on the size of CharType (e.g. wchar_t, char16_t or char32_t).
+    /// Invalid sequences, i.e. unpaired surrogates, are replaced with the replacement character
+    /// (see #BOOST_NOWIDE_REPLACEMENT_CHARACTER).
+    /// Results and mbstate_t handling follow those of utf8_codecvt, so it can be imbued into a wide file stream
+    /// to read UTF-16 files directly.
+    ///
+    template<typename CharType, utf16_byte_order ByteOrder = utf16_le, int CharSize = sizeof(CharType)>
+    class utf16_codecvt;
+
+    template<typename CharType, utf16_byte_order ByteOrder>
+    class utf16_codecvt<CharType, ByteOrder, 2> : public std::codecvt<CharType, char, std::mbstate_t>
+    {
+    public:
+        utf16_codecvt(size_t refs = 0) : std::codecvt<CharType, char, std::mbstate_t>(refs)
+        {}
+
+        typedef CharType uchar;
+
+        ///
+        /// Convert UTF-16 bytes in [from, from_end) to UTF-16 in [to, to_end), same as std::codecvt::in but non-virtual
+        ///
+        static std::codecvt_base::result convert_in(std::mbstate_t &std_state,
+                                                    char const *from,
+                                                    char const *from_end,
+                                                    char const *&from_next,
+                                                    uchar *to,
+                                                    uchar *to_end,
+                                                    uchar *&to_next)
+        {
+            std::codecvt_base::result r = std::codecvt_base::ok;
+            // state is 1 if the high surrogate of a valid pair was written but the low one not yet
+            boost::uint16_t &state = *reinterpret_cast<boost::uint16_t *>(&std_state);
+            while(to < to_end && from_end - from >= 2)
+            {
+                if(state == 0)
+                {
+                    size_t const n =
+                      details::read_bmp_units<ByteOrder>(from, to, std::min<size_t>((from_end - from) / 2, to_end - to));
+                    from += 2 * n;
+                    to += n;
+                    if(to == to_end || from_end - from < 2)
+                        break;
+                }
+                boost::uint16_t const w1 = details::read_utf16_unit<ByteOrder>(from);
+                if(state != 0)
+                {
+                    // Second part of a pair that was already validated
+                    *to++ = w1;
+                    from += 2;
+                    state = 0;
+                } else if(details::is_high_surrogate(w1))
+                {
+                    if(from_end - from < 4)
+                    {
+                        r = std::codecvt_base::partial;
+                        break;
+                    }
+                    boost::uint16_t const w2 = details::read_utf16_unit<ByteOrder>(from + 2);
+                    if(!details::is_low_surrogate(w2))
+                    {
+                        *to++ = BOOST_NOWIDE_REPLACEMENT_CHARACTER;
+                        from += 2;
+                    } else if(to_end - to >= 2)
+                    {
+                        *to++ = w1;
+                        *to++ = w2;
+                        from += 4;
+                    } else
+                    {
+                        // Only room for the high surrogate, remember that the low one is valid
+                        *to++ = w1;
+                        from += 2;
+                        state = 1;
+                    }
+                } else
+                {
+                    // Unpaired low surrogate
+                    *to++ = BOOST_NOWIDE_REPLACEMENT_CHARACTER;
+                    from += 2;
+                }
+            }
+            from_next = from;
+            to_next = to;
+            if(r == std::codecvt_base::ok && (from != from_end || state != 0))
+                r = std::codecvt_base::partial;
+            return r;
+        }
+
+        ///
+        /// Convert UTF-16 in [from, from_end) to UTF-16 bytes in [to, to_end), same as std::codecvt::out but non-virtual
+        ///
+        static std::codecvt_base::result convert_out(std::mbstate_t &std_state,
+                                                     uchar const *from,
+                                                     uchar const *from_end,
+                                                     uchar const *&from_next,
+                                                     char *to,
+                                                     char *to_end,
+                                                     char *&to_next)
+        {
+            std::codecvt_base::result r = std::codecvt_base::ok;
+            // State: state!=0 - a high surrogate was observed (state = high surrogate) but not yet written
+            boost::uint16_t &state = *reinterpret_cast<boost::uint16_t *>(&std_state);
+            while(to_end - to >= 2 && from < from_end)
+            {
+                if(state == 0)
+                {
+                    size_t const n = details::write_bmp_units<ByteOrder>(from, to, std::min<size_t>(from_end - from, (to_end - to) / 2));
+                    from += n;
+                    to += 2 * n;
+                    if(to_end - to < 2 || from == from_end)
+                        break;
+                }
+                boost::uint16_t const w = static_cast<boost::uint16_t>(*from);
+                if(state != 0)
+                {
+                    if(details::is_low_surrogate(w))
+                    {
+                        if(to_end - to < 4)
+                        {
+                            r = std::codecvt_base::partial;
+                            break;
+                        }
+                        to = details::write_utf16_unit<ByteOrder>(state, to);
+                        to = details::write_utf16_unit<ByteOrder>(w, to);
+                        from++;
+                    } else
+                    {
+                        // Unpaired high surrogate, process the current character again
+                        to = details::write_utf16_unit<ByteOrder>(BOOST_NOWIDE_REPLACEMENT_CHARACTER, to);
+                    }
+                    state = 0;
+                } else if(details::is_high_surrogate(w))
+                {
+                    state = w;
+                    from++;
+                } else
+                {
+                    // Unpaired low surrogate
+                    to = details::write_utf16_unit<ByteOrder>(BOOST_NOWIDE_REPLACEMENT_CHARACTER, to);
+                    from++;
+                }
+            }
+            from_next = from;
+            to_next = to;
+            if(r == std::codecvt_base::ok && from != from_end)
+                r = std::codecvt_base::partial;
+            return r;
+        }
+
+    protected:
+        virtual std::codecvt_base::result do_unshift(std::mbstate_t &s, char *from, char * /*to*/, char *&next) const
+        {
+            boost::uint16_t &state = *reinterpret_cast<boost::uint16_t *>(&s);
+            if(state != 0)
+                return std::codecvt_base::error;
+            next = from;
+            return std::codecvt_base::ok;
+        }
+        virtual int do_encoding() const throw()
+        {
+            return 0;
+        }
+        virtual int do_max_length() const throw()
+        {
+            return 4;
+        }
+        virtual bool do_always_noconv() const throw()
+        {
+            return false;
+        }
+
+        virtual int do_length(std::mbstate_t
+#ifdef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+                              const
+#endif
+                                &std_state,
+                              char const *from,
+                              char const *from_end,
+                              size_t max) const
+        {
+#ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+            std::mbstate_t &state = std_state;
+#else
+            std::mbstate_t state = std_state;
+#endif
+            return details::utf16_length<utf16_codecvt>(state, from, from_end, max);
+        }
+
+        virtual std::codecvt_base::result do_in(std::mbstate_t &state,
+                                                char const *from,
+                                                char const *from_end,
+                                                char const *&from_next,
+                                                uchar *to,
+                                                uchar *to_end,
+                                                uchar *&to_next) const
+        {
+            return convert_in(state, from, from_end, from_next, to, to_end, to_next);
+        }
+
+        virtual std::codecvt_base::result do_out(std::mbstate_t &state,
+                                                 uchar const *from,
+                                                 uchar const *from_end,
+                                                 uchar const *&from_next,
+                                                 char *to,
+                                                 char *to_end,
+                                                 char *&to_next) const
+        {
+            return convert_out(state, from, from_end, from_next, to, to_end, to_next);
+        }
+    };
+
+    template<typename CharType, utf16_byte_order ByteOrder>
+    class utf16_codecvt<CharType, ByteOrder, 4> : public std::codecvt<CharType, char, std::mbstate_t>
+    {
+    public:
+        utf16_codecvt(size_t refs = 0) : std::codecvt<CharType, char, std::mbstate_t>(refs)
+        {}
+
+        typedef CharType uchar;
+
+        ///
+        /// Convert UTF-16 bytes in [from, from_end) to UTF-32 in [to, to_end), same as std::codecvt::in but non-virtual
+        ///
+        static std::codecvt_base::result convert_in(std::mbstate_t & /*state*/,
+                                                    char const *from,
+                                                    char const *from_end,
+                                                    char const *&from_next,
+                                                    uchar *to,
+                                                    uchar *to_end,
+                                                    uchar *&to_next)
+        {
+            std::codecvt_base::result r = std::codecvt_base::ok;
+            while(to < to_end && from_end - from >= 2)
+            {
+                size_t const n = details::read_bmp_units<ByteOrder>(from, to, std::min<size_t>((from_end - from) / 2, to_end - to));
+                from += 2 * n;
+                to += n;
+                if(to == to_end || from_end - from < 2)
+                    break;
+                boost::uint16_t const w1 = details::read_utf16_unit<ByteOrder>(from);
+                if(details::is_high_surrogate(w1))
+                {
+                    if(from_end - from < 4)
+                    {
+                        r = std::codecvt_base::partial;
+                        break;
+                    }
+                    boost::uint16_t const w2 = details::read_utf16_unit<ByteOrder>(from + 2);
+                    if(details::is_low_surrogate(w2))
+                    {
+                        *to++ = ((boost::uint32_t(w1 - 0xD800) << 10) | (w2 - 0xDC00)) + 0x10000;
+                        from += 4;
+                        continue;
+                    }
+                }
+                // Unpaired surrogate
+                *to++ = BOOST_NOWIDE_REPLACEMENT_CHARACTER;
+                from += 2;
+            }
+            from_next = from;
+            to_next = to;
+            if(r == std::codecvt_base::ok && from != from_end)
+                r = std::codecvt_base::partial;
+            return r;
+        }
+
+        ///
+        /// Convert UTF-32 in [from, from_end) to UTF-16 bytes in [to, to_end), same as std::codecvt::out but non-virtual
+        ///
+        static std::codecvt_base::result convert_out(std::mbstate_t & /*state*/,
+                                                     uchar const *from,
+                                                     uchar const *from_end,
+                                                     uchar const *&from_next,
+                                                     char *to,
+                                                     char *to_end,
+                                                     char *&to_next)
+        {
+            std::codecvt_base::result r = std::codecvt_base::ok;
+            while(to_end - to >= 2 && from < from_end)
+            {
+                size_t const n = details::write_bmp_units<ByteOrder>(from, to, std::min<size_t>(from_end - from, (to_end - to) / 2));
+                from += n;
+                to += 2 * n;
+                if(to_end - to < 2 || from == from_end)
+                    break;
+                boost::uint32_t ch = details::code_unit(*from);
+                if(!boost::locale::utf::is_valid_codepoint(ch))
+                    ch = BOOST_NOWIDE_REPLACEMENT_CHARACTER;
+                if(ch > 0xFFFF)
+                {
+                    if(to_end - to < 4)
+                    {
+                        r = std::codecvt_base::partial;
+                        break;
+                    }
+                    ch -= 0x10000;
+                    to = details::write_utf16_unit<ByteOrder>(0xD800 + (ch >> 10), to);
+                    to = details::write_utf16_unit<ByteOrder>(0xDC00 + (ch & 0x3FF), to);
+                } else
+                {
+                    to = details::write_utf16_unit<ByteOrder>(ch, to);
+                }
+                from++;
+            }
+            from_next = from;
+            to_next = to;
+            if(r == std::codecvt_base::ok && from != from_end)
+                r = std::codecvt_base::partial;
+            return r;
+        }
+
+    protected:
+        virtual std::codecvt_base::result do_unshift(std::mbstate_t & /*s*/, char *from, char * /*to*/, char *&next) const
+        {
+            next = from;
+            return std::codecvt_base::ok;
+        }
+        virtual int do_encoding() const throw()
+        {
+            return 0;
+        }
+        virtual int do_max_length() const throw()
+        {
+            return 4;
+        }
+        virtual bool do_always_noconv() const throw()
+        {
+            return false;
+        }
+
+        virtual int do_length(std::mbstate_t
+#ifdef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+                              const
+#endif
+                                &std_state,
+                              char const *from,
+                              char const *from_end,
+                              size_t max) const
+        {
+            std::mbstate_t state = std_state;
+            return details::utf16_length<utf16_codecvt>(state, from, from_end, max);
+        }
+
+        virtual std::codecvt_base::result do_in(std::mbstate_t &state,
+                                                char const *from,
+                                                char const *from_end,
+                                                char const *&from_next,
+                                                uchar *to,
+                                                uchar *to_end,
+                                                uchar *&to_next) const
+        {
+            return convert_in(state, from, from_end, from_next, to, to_end, to_next);
+        }
+
+        virtual std::codecvt_base::result do_out(std::mbstate_t &state,
+                                                 uchar const *from,
+                                                 uchar const *from_end,
+                                                 uchar const *&from_next,
+                                                 char *to,
+                                                 char *to_end,
+                                                 char *&to_next) const
+        {
+            return convert_out(state, from, from_end, from_next, to, to_end, to_next);
+        }
+    };
+
+} // namespace nowide
+} // namespace boost
+
+#endif
+///
+// vim: tabstop=4 expandtab shiftwidth=4 softtabstop=4
@@ -12,6 +12,9 @@
 #include <boost/cstdint.hpp>
 #include <boost/nowide/replacement.hpp>
 #include <boost/static_assert.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <locale>
 
 namespace boost {
@@ -27,95 +30,98 @@ namespace nowide {
 #define BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
 #endif
 
-    template<typename CharType, int CharSize = sizeof(CharType)>
-    class utf8_codecvt;
-
-    template<typename CharType>
-    class utf8_codecvt<CharType, 2> : public std::codecvt<CharType, char, std::mbstate_t>
-    {
-    public:
-        utf8_codecvt(size_t refs = 0) : std::codecvt<CharType, char, std::mbstate_t>(refs)
-        {}
-
-    protected:
-        typedef CharType uchar;
+    /// \cond INTERNAL
+    namespace details {
+        ///
+        /// Number of code units checked at once when looking for ASCII runs.
+        /// Fixed size inner loops allow the compiler to vectorize them
+        ///
+        static const size_t ascii_block_size = 16;
 
-        virtual std::codecvt_base::result do_unshift(std::mbstate_t &s, char *from, char * /*to*/, char *&next) const
+        inline boost::uint32_t code_unit(char c)
         {
-            boost::uint16_t &state = *reinterpret_cast<boost::uint16_t *>(&s);
-            if(state != 0)
-                return std::codecvt_base::error;
-            next = from;
-            return std::codecvt_base::ok;
+            return static_cast<unsigned char>(c);
         }
-        virtual int do_encoding() const throw()
+        template<typename CharType>
+        inline boost::uint32_t code_unit(CharType c)
         {
-            return 0;
+            return static_cast<boost::uint32_t>(c);
         }
-        virtual int do_max_length() const throw()
-        {
-            return 4;
-        }
-        virtual bool do_always_noconv() const throw()
+
+        ///
+        /// Copy the longest prefix of at most \a n ASCII characters from \a from to \a to
+        /// and return its length. Works for narrow->wide and wide->narrow conversions
+        ///
+        template<typename CharIn, typename CharOut>
+        inline size_t copy_ascii(CharIn const *from, CharOut *to, size_t n)
         {
-            return false;
+            // Most calls happen right before a non-ASCII character, so bail out early
+            if(n == 0 || code_unit(*from) >= 0x80)
+                return 0;
+            size_t i = 0;
+            for(; i + ascii_block_size <= n; i += ascii_block_size)
+            {
+                boost::uint32_t mask = 0;
+                for(size_t j = 0; j < ascii_block_size; j++)
+                    mask |= code_unit(from[i + j]);
+                if(mask >= 0x80)
+                    break;
+                for(size_t j = 0; j < ascii_block_size; j++)
+                    to[i + j] = static_cast<CharOut>(code_unit(from[i + j]));
+            }
+            for(; i < n && code_unit(from[i]) < 0x80; i++)
+                to[i] = static_cast<CharOut>(code_unit(from[i]));
+            return i;
         }
 
-        virtual int do_length(std::mbstate_t
-#ifdef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
-                              const
-#endif
-                                &std_state,
-                              char const *from,
-                              char const *from_end,
-                              size_t max) const
+        ///
+        /// Return the length of the longest prefix of at most \a n ASCII characters starting at \a from
+        ///
+        inline size_t count_ascii(char const *from, size_t n)
         {
-#ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
-            char const *save_from = from;
-            boost::uint16_t &state = *reinterpret_cast<boost::uint16_t *>(&std_state);
-#else
-            size_t save_max = max;
-            boost::uint16_t state = *reinterpret_cast<boost::uint16_t const *>(&std_state);
-#endif
-            while(max > 0 && from < from_end)
+            if(n == 0 || code_unit(*from) >= 0x80)
+                return 0;
+            size_t i = 0;
+            for(; i + ascii_block_size <= n; i += ascii_block_size)
             {
-                char const *prev_from = from;
-                boost::uint32_t ch = boost::locale::utf::utf_traits<char>::decode(from, from_end);
-                if(ch == boost::locale::utf::illegal)
-                {
-                    ch = BOOST_NOWIDE_REPLACEMENT_CHARACTER;
-                } else if(ch == boost::locale::utf::incomplete)
-                {
-                    from = prev_from;
+                boost::uint32_t mask = 0;
+                for(size_t j = 0; j < ascii_block_size; j++)
+                    mask |= code_unit(from[i + j]);
+                if(mask >= 0x80)
                     break;
-                }
-                max--;
-                if(ch > 0xFFFF)
-                {
-                    if(state == 0)
-                    {
-                        from = prev_from;
-                        state = 1;
-                    } else
-                    {
-                        state = 0;
-                    }
-                }
             }
-#ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
-            return static_cast<int>(from - save_from);
-#else
-            return static_cast<int>(save_max - max);
-#endif
+            while(i < n && code_unit(from[i]) < 0x80)
+                i++;
+            return i;
         }
+    } // namespace details
+    /// \endcond
 
-        virtual std::codecvt_base::result do_in(std::mbstate_t &std_state,
-                                                char const *from,
-                                                char const *from_end,
-                                                char const *&from_next,
-                                                uchar *to,
-                                                uchar *to_end,
-                                                uchar *&to_next) const
+    template<typename CharType, int CharSize = sizeof(CharType)>
+    class utf8_codecvt;
+
+    template<typename CharType>
+    class utf8_codecvt<CharType, 2> : public std::codecvt<CharType, char, std::mbstate_t>
+    {
+    public:
+        utf8_codecvt(size_t refs = 0) : std::codecvt<CharType, char, std::mbstate_t>(refs)
+        {}
+
+        typedef CharType uchar;
+
+        ///
+        /// Convert UTF-8 in [from, from_end) to UTF-16 in [to, to_end), same as std::codecvt::in but non-virtual
+        ///
+        /// The virtual do_in delegates to this function, so it can be used directly to convert buffers without
+        /// a std::locale and without virtual calls.
+        ///
+        static std::codecvt_base::result convert_in(std::mbstate_t &std_state,
+                                                    char const *from,
+                                                    char const *from_end,
+                                                    char const *&from_next,
+                                                    uchar *to,
+                                                    uchar *to_end,
+                                                    uchar *&to_next)
         {
             std::codecvt_base::result r = std::codecvt_base::ok;
 
@@ -127,6 +133,15 @@ namespace nowide {
             boost::uint16_t &state = *reinterpret_cast<boost::uint16_t *>(&std_state);
             while(to < to_end && from < from_end)
             {
+                // Convert runs of ASCII characters at once
+                if(state == 0)
+                {
+                    size_t const n = details::copy_ascii(from, to, std::min<size_t>(from_end - from, to_end - to));
+                    from += n;
+                    to += n;
+                    if(to == to_end || from == from_end)
+                        break;
+                }
                 char const *from_saved = from;
 
                 uint32_t ch = boost::locale::utf::utf_traits<char>::decode(from, from_end);
@@ -148,10 +163,12 @@ namespace nowide {
                 {
                     // for  other codepoints we do following
                     //
-                    // 1. We can't consume our input as we may find ourselfs
+                    // 1. If there is room for both surrogates we write them and consume the input.
+                    //    This is the common case and avoids decoding the codepoint twice
+                    // 2. Otherwise we can't consume our input as we may find ourselfs
                     //    in state where all input consumed but not all output written,i.e. only
                     //    1st pair is written
-                    // 2. We only write first pair and mark this in the state, we also revert back
+                    // 3. We only write first pair and mark this in the state, we also revert back
                     //    the from pointer in order to make sure this codepoint would be read
                     //    once again and then we would consume our input together with writing
                     //    second surrogate pair
@@ -160,7 +177,11 @@ namespace nowide {
                     boost::uint16_t vl = ch & 0x3FF;
                     boost::uint16_t w1 = vh + 0xD800;
                     boost::uint16_t w2 = vl + 0xDC00;
-                    if(state == 0)
+                    if(state == 0 && to_end - to >= 2)
+                    {
+                        *to++ = w1;
+                        *to++ = w2;
+                    } else if(state == 0)
                     {
                         from = from_saved;
                         *to++ = w1;
@@ -179,13 +200,16 @@ namespace nowide {
             return r;
         }
 
-        virtual std::codecvt_base::result do_out(std::mbstate_t &std_state,
-                                                 uchar const *from,
-                                                 uchar const *from_end,
-                                                 uchar const *&from_next,
-                                                 char *to,
-                                                 char *to_end,
-                                                 char *&to_next) const
+        ///
+        /// Convert UTF-16 in [from, from_end) to UTF-8 in [to, to_end), same as std::codecvt::out but non-virtual
+        ///
+        static std::codecvt_base::result convert_out(std::mbstate_t &std_state,
+                                                     uchar const *from,
+                                                     uchar const *from_end,
+                                                     uchar const *&from_next,
+                                                     char *to,
+                                                     char *to_end,
+                                                     char *&to_next)
         {
             std::codecvt_base::result r = std::codecvt_base::ok;
             // mbstate_t is POD type and should be initialized to 0 (i.a. state = stateT())
@@ -198,6 +222,15 @@ namespace nowide {
             boost::uint16_t &state = *reinterpret_cast<boost::uint16_t *>(&std_state);
             while(to < to_end && from < from_end)
             {
+                // Convert runs of ASCII characters at once
+                if(state == 0)
+                {
+                    size_t const n = details::copy_ascii(from, to, std::min<size_t>(from_end - from, to_end - to));
+                    from += n;
+                    to += n;
+                    if(to == to_end || from == from_end)
+                        break;
+                }
                 boost::uint32_t ch = 0;
                 if(state != 0)
                 {
@@ -258,20 +291,14 @@ namespace nowide {
                 r = std::codecvt_base::partial;
             return r;
         }
-    };
-
-    template<typename CharType>
-    class utf8_codecvt<CharType, 4> : public std::codecvt<CharType, char, std::mbstate_t>
-    {
-    public:
-        utf8_codecvt(size_t refs = 0) : std::codecvt<CharType, char, std::mbstate_t>(refs)
-        {}
 
     protected:
-        typedef CharType uchar;
 
-        virtual std::codecvt_base::result do_unshift(std::mbstate_t & /*s*/, char *from, char * /*to*/, char *&next) const
+        virtual std::codecvt_base::result do_unshift(std::mbstate_t &s, char *from, char * /*to*/, char *&next) const
         {
+            boost::uint16_t &state = *reinterpret_cast<boost::uint16_t *>(&s);
+            if(state != 0)
+                return std::codecvt_base::error;
             next = from;
             return std::codecvt_base::ok;
         }
@@ -292,45 +319,108 @@ namespace nowide {
 #ifdef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
                               const
 #endif
-                                & /*state*/,
+                                &std_state,
                               char const *from,
                               char const *from_end,
                               size_t max) const
         {
 #ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
-            char const *start_from = from;
+            char const *save_from = from;
+            boost::uint16_t &state = *reinterpret_cast<boost::uint16_t *>(&std_state);
 #else
             size_t save_max = max;
+            boost::uint16_t state = *reinterpret_cast<boost::uint16_t const *>(&std_state);
 #endif
-
             while(max > 0 && from < from_end)
             {
-                char const *save_from = from;
-                boost::uint32_t ch = boost::locale::utf::utf_traits<char>::decode(from, from_end);
-                if(ch == boost::locale::utf::incomplete)
+                // Skip runs of ASCII characters at once
+                if(state == 0)
                 {
-                    from = save_from;
-                    break;
-                } else if(ch == boost::locale::utf::illegal)
+                    size_t const n = details::count_ascii(from, std::min<size_t>(from_end - from, max));
+                    from += n;
+                    max -= n;
+                    if(max == 0 || from == from_end)
+                        break;
+                }
+                char const *prev_from = from;
+                boost::uint32_t ch = boost::locale::utf::utf_traits<char>::decode(from, from_end);
+                if(ch == boost::locale::utf::illegal)
                 {
                     ch = BOOST_NOWIDE_REPLACEMENT_CHARACTER;
+                } else if(ch == boost::locale::utf::incomplete)
+                {
+                    from = prev_from;
+                    break;
                 }
                 max--;
+                if(ch > 0xFFFF)
+                {
+                    // Same as in convert_in: Both surrogates are produced at once if there is room for them
+                    if(state == 0 && max > 0)
+                    {
+                        max--;
+                    } else if(state == 0)
+                    {
+                        from = prev_from;
+                        state = 1;
+                    } else
+                    {
+                        state = 0;
+                    }
+                }
             }
 #ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
-            return from - start_from;
+            return static_cast<int>(from - save_from);
 #else
-            return save_max - max;
+            return static_cast<int>(save_max - max);
 #endif
         }
 
-        virtual std::codecvt_base::result do_in(std::mbstate_t & /*state*/,
+        virtual std::codecvt_base::result do_in(std::mbstate_t &state,
                                                 char const *from,
                                                 char const *from_end,
                                                 char const *&from_next,
                                                 uchar *to,
                                                 uchar *to_end,
                                                 uchar *&to_next) const
+        {
+            return convert_in(state, from, from_end, from_next, to, to_end, to_next);
+        }
+
+        virtual std::codecvt_base::result do_out(std::mbstate_t &state,
+                                                 uchar const *from,
+                                                 uchar const *from_end,
+                                                 uchar const *&from_next,
+                                                 char *to,
+                                                 char *to_end,
+                                                 char *&to_next) const
+        {
+            return convert_out(state, from, from_end, from_next, to, to_end, to_next);
+        }
+    };
+
+    template<typename CharType>
+    class utf8_codecvt<CharType, 4> : public std::codecvt<CharType, char, std::mbstate_t>
+    {
+    public:
+        utf8_codecvt(size_t refs = 0) : std::codecvt<CharType, char, std::mbstate_t>(refs)
+        {}
+
+        typedef CharType uchar;
+
+        ///
+        /// Convert UTF-8 in [from, from_end) to UTF-32 in [to, to_end), same as std::codecvt::in but non-virtual
+        ///
+        /// The virtual do_in delegates to this function, so it can be used directly to convert buffers without
+        /// a std::locale and without virtual calls.
+        ///
+        static std::codecvt_base::result convert_in(std::mbstate_t & /*state*/,
+                                                    char const *from,
+                                                    char const *from_end,
+                                                    char const *&from_next,
+                                                    uchar *to,
+                                                    uchar *to_end,
+                                                    uchar *&to_next)
         {
             std::codecvt_base::result r = std::codecvt_base::ok;
 
@@ -341,6 +431,12 @@ namespace nowide {
             // and first pair is written, but no input consumed
             while(to < to_end && from < from_end)
             {
+                // Convert runs of ASCII characters at once
+                size_t const n = details::copy_ascii(from, to, std::min<size_t>(from_end - from, to_end - to));
+                from += n;
+                to += n;
+                if(to == to_end || from == from_end)
+                    break;
                 char const *from_saved = from;
 
                 uint32_t ch = boost::locale::utf::utf_traits<char>::decode(from, from_end);
@@ -363,17 +459,26 @@ namespace nowide {
             return r;
         }
 
-        virtual std::codecvt_base::result do_out(std::mbstate_t & /*std_state*/,
-                                                 uchar const *from,
-                                                 uchar const *from_end,
-                                                 uchar const *&from_next,
-                                                 char *to,
-                                                 char *to_end,
-                                                 char *&to_next) const
+        ///
+        /// Convert UTF-32 in [from, from_end) to UTF-8 in [to, to_end), same as std::codecvt::out but non-virtual
+        ///
+        static std::codecvt_base::result convert_out(std::mbstate_t & /*std_state*/,
+                                                     uchar const *from,
+                                                     uchar const *from_end,
+                                                     uchar const *&from_next,
+                                                     char *to,
+                                                     char *to_end,
+                                                     char *&to_next)
         {
             std::codecvt_base::result r = std::codecvt_base::ok;
             while(to < to_end && from < from_end)
             {
+                // Convert runs of ASCII characters at once
+                size_t const n = details::copy_ascii(from, to, std::min<size_t>(from_end - from, to_end - to));
+                from += n;
+                to += n;
+                if(to == to_end || from == from_end)
+                    break;
                 boost::uint32_t ch = 0;
                 ch = *from;
                 if(!boost::locale::utf::is_valid_codepoint(ch))
@@ -395,6 +500,262 @@ namespace nowide {
                 r = std::codecvt_base::partial;
             return r;
         }
+
+    protected:
+
+        virtual std::codecvt_base::result do_unshift(std::mbstate_t & /*s*/, char *from, char * /*to*/, char *&next) const
+        {
+            next = from;
+            return std::codecvt_base::ok;
+        }
+        virtual int do_encoding() const throw()
+        {
+            return 0;
+        }
+        virtual int do_max_length() const throw()
+        {
+            return 4;
+        }
+        virtual bool do_always_noconv() const throw()
+        {
+            return false;
+        }
+
+        virtual int do_length(std::mbstate_t
+#ifdef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+                              const
+#endif
+                                & /*state*/,
+                              char const *from,
+                              char const *from_end,
+                              size_t max) const
+        {
+#ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+            char const *start_from = from;
+#else
+            size_t save_max = max;
+#endif
+
+            while(max > 0 && from < from_end)
+            {
+                // Skip runs of ASCII characters at once
+                size_t const n = details::count_ascii(from, std::min<size_t>(from_end - from, max));
+                from += n;
+                max -= n;
+                if(max == 0 || from == from_end)
+                    break;
+                char const *save_from = from;
+                boost::uint32_t ch = boost::locale::utf::utf_traits<char>::decode(from, from_end);
+                if(ch == boost::locale::utf::incomplete)
+                {
+                    from = save_from;
+                    break;
+                } else if(ch == boost::locale::utf::illegal)
+                {
+                    ch = BOOST_NOWIDE_REPLACEMENT_CHARACTER;
+                }
+                max--;
+            }
+#ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+            return from - start_from;
+#else
+            return save_max - max;
+#endif
+        }
+
+        virtual std::codecvt_base::result do_in(std::mbstate_t &state,
+                                                char const *from,
+                                                char const *from_end,
+                                                char const *&from_next,
+                                                uchar *to,
+                                                uchar *to_end,
+                                                uchar *&to_next) const
+        {
+            return convert_in(state, from, from_end, from_next, to, to_end, to_next);
+        }
+
+        virtual std::codecvt_base::result do_out(std::mbstate_t &state,
+                                                 uchar const *from,
+                                                 uchar const *from_end,
+                                                 uchar const *&from_next,
+                                                 char *to,
+                                                 char *to_end,
+                                                 char *&to_next) const
+        {
+            return convert_out(state, from, from_end, from_next, to, to_end, to_next);
+        }
+    };
+
+    ///
+    /// \brief Facet that validates UTF-8 passing through a narrow stream
+    ///
+    /// The external and internal encodings are both UTF-8. Valid input is passed through unchanged,
+    /// invalid sequences are either replaced with the replacement character (see #BOOST_NOWIDE_REPLACEMENT_CHARACTER)
+    /// or reported as a conversion error, depending on the \a replace_invalid constructor argument.
+    /// Incomplete sequences at the end of a buffer result in a partial conversion just like in utf8_codecvt.
+    ///
+    /// Imbue it into a std::basic_filebuf<char> based stream to validate UTF-8 while reading or writing it.
+    /// Note that boost::nowide::basic_filebuf does not support converting facets.
+    ///
+    template<typename CharType>
+    class utf8_validating_codecvt;
+
+    template<>
+    class utf8_validating_codecvt<char> : public std::codecvt<char, char, std::mbstate_t>
+    {
+    public:
+        explicit utf8_validating_codecvt(bool replace_invalid = true, size_t refs = 0) :
+            std::codecvt<char, char, std::mbstate_t>(refs), replace_invalid_(replace_invalid)
+        {}
+
+        ///
+        /// Validate [from, from_end) and copy it to [to, to_end), see std::codecvt::in
+        ///
+        std::codecvt_base::result
+        validate(char const *from, char const *from_end, char const *&from_next, char *to, char *to_end, char *&to_next) const
+        {
+            std::codecvt_base::result r = std::codecvt_base::ok;
+            while(from < from_end && to < to_end)
+            {
+                // Valid runs are copied at once
+                size_t const n = valid_length(from, from_end, static_cast<size_t>(to_end - to));
+                std::memcpy(to, from, n);
+                from += n;
+                to += n;
+                if(from == from_end || to == to_end)
+                    break;
+                char const *from_saved = from;
+                boost::uint32_t ch = boost::locale::utf::utf_traits<char>::decode(from, from_end);
+                if(ch == boost::locale::utf::incomplete)
+                {
+                    from = from_saved;
+                    r = std::codecvt_base::partial;
+                    break;
+                } else if(ch != boost::locale::utf::illegal)
+                {
+                    // A valid sequence that did not fit into the output
+                    from = from_saved;
+                    break;
+                } else if(!replace_invalid_)
+                {
+                    from = from_saved;
+                    r = std::codecvt_base::error;
+                    break;
+                }
+                if(to_end - to < boost::locale::utf::utf_traits<char>::width(BOOST_NOWIDE_REPLACEMENT_CHARACTER))
+                {
+                    from = from_saved;
+                    break;
+                }
+                to = boost::locale::utf::utf_traits<char>::encode(BOOST_NOWIDE_REPLACEMENT_CHARACTER, to);
+            }
+            from_next = from;
+            to_next = to;
+            if(r == std::codecvt_base::ok && from != from_end)
+                r = std::codecvt_base::partial;
+            return r;
+        }
+
+    protected:
+        virtual std::codecvt_base::result do_unshift(std::mbstate_t & /*s*/, char *from, char * /*to*/, char *&next) const
+        {
+            next = from;
+            return std::codecvt_base::ok;
+        }
+        virtual int do_encoding() const throw()
+        {
+            return 0;
+        }
+        virtual int do_max_length() const throw()
+        {
+            return 4;
+        }
+        virtual bool do_always_noconv() const throw()
+        {
+            return false;
+        }
+
+        virtual int do_length(std::mbstate_t
+#ifdef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+                              const
+#endif
+                                & /*state*/,
+                              char const *from,
+                              char const *from_end,
+                              size_t max) const
+        {
+            char const *const start_from = from;
+            size_t const save_max = max;
+            while(from < from_end && max > 0)
+            {
+                size_t const n = valid_length(from, from_end, max);
+                from += n;
+                max -= n;
+                if(from == from_end || max == 0)
+                    break;
+                char const *from_saved = from;
+                boost::uint32_t ch = boost::locale::utf::utf_traits<char>::decode(from, from_end);
+                size_t const width = boost::locale::utf::utf_traits<char>::width(BOOST_NOWIDE_REPLACEMENT_CHARACTER);
+                if(ch != boost::locale::utf::illegal || !replace_invalid_ || max < width)
+                {
+                    from = from_saved;
+                    break;
+                }
+                max -= width;
+            }
+#ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+            (void)save_max;
+            return static_cast<int>(from - start_from);
+#else
+            (void)start_from;
+            return static_cast<int>(save_max - max);
+#endif
+        }
+
+        virtual std::codecvt_base::result do_in(std::mbstate_t & /*state*/,
+                                                char const *from,
+                                                char const *from_end,
+                                                char const *&from_next,
+                                                char *to,
+                                                char *to_end,
+                                                char *&to_next) const
+        {
+            return validate(from, from_end, from_next, to, to_end, to_next);
+        }
+
+        virtual std::codecvt_base::result do_out(std::mbstate_t & /*state*/,
+                                                 char const *from,
+                                                 char const *from_end,
+                                                 char const *&from_next,
+                                                 char *to,
+                                                 char *to_end,
+                                                 char *&to_next) const
+        {
+            return validate(from, from_end, from_next, to, to_end, to_next);
+        }
+
+    private:
+        /// Return the length of the longest prefix of complete and valid UTF-8 sequences
+        /// in [from, from_end) which is at most \a max chars long
+        static size_t valid_length(char const *from, char const *from_end, size_t max)
+        {
+            char const *const start = from;
+            char const *const end = from + std::min<size_t>(from_end - from, max);
+            while(from < end)
+            {
+                from += details::count_ascii(from, end - from);
+                if(from == end)
+                    break;
+                char const *next = from;
+                boost::uint32_t ch = boost::locale::utf::utf_traits<char>::decode(next, end);
+                if(ch == boost::locale::utf::illegal || ch == boost::locale::utf::incomplete)
+                    break;
+                from = next;
+            }
+            return from - start;
+        }
+
+        bool replace_invalid_;
     };
 
 } // namespace nowide
@@ -0,0 +1,118 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_NOWIDE_SOURCE
+#include <boost/nowide/async_file.hpp>
+
+#if BOOST_NOWIDE_HAS_ASYNC_FILE && defined(BOOST_WINDOWS)
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+
+namespace boost {
+namespace nowide {
+
+    namespace {
+        /// Set up an OVERLAPPED for a synchronous I/O at offset
+        void set_offset(OVERLAPPED &ov, std::streamoff offset)
+        {
+            ZeroMemory(&ov, sizeof(ov));
+            ULARGE_INTEGER off;
+            off.QuadPart = static_cast<ULONGLONG>(offset);
+            ov.Offset = off.LowPart;
+            ov.OffsetHigh = off.HighPart;
+        }
+        std::ptrdiff_t last_error()
+        {
+            return -static_cast<std::ptrdiff_t>(GetLastError());
+        }
+    } // namespace
+
+    async_file::async_file() : handle_(INVALID_HANDLE_VALUE)
+    {}
+    async_file::async_file(char const *name, std::ios_base::openmode mode) : handle_(INVALID_HANDLE_VALUE)
+    {
+        open(name, mode);
+    }
+    async_file::~async_file()
+    {
+        close();
+    }
+    bool async_file::open(wchar_t const *name, std::ios_base::openmode mode)
+    {
+        if(is_open() || !get_mode(mode))
+            return false;
+        DWORD access = 0;
+        if(mode & std::ios_base::in)
+            access |= GENERIC_READ;
+        if(mode & std::ios_base::out)
+            access |= GENERIC_WRITE;
+        DWORD const disposition =
+          (mode == std::ios_base::in || mode == (std::ios_base::in | std::ios_base::out)) ? OPEN_EXISTING : CREATE_ALWAYS;
+        handle_ = CreateFileW(name,
+                              access,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL,
+                              disposition,
+                              FILE_ATTRIBUTE_NORMAL,
+                              NULL);
+        return handle_ != INVALID_HANDLE_VALUE;
+    }
+    bool async_file::is_open() const
+    {
+        return handle_ != INVALID_HANDLE_VALUE;
+    }
+    bool async_file::close()
+    {
+        if(!is_open())
+            return true;
+        bool const res = CloseHandle(handle_) != 0;
+        handle_ = INVALID_HANDLE_VALUE;
+        return res;
+    }
+    std::streamoff async_file::size() const
+    {
+        LARGE_INTEGER size;
+        if(!GetFileSizeEx(handle_, &size))
+            return -1;
+        return size.QuadPart;
+    }
+    std::ptrdiff_t async_file::read_at(std::streamoff offset, char *data, size_t n)
+    {
+        OVERLAPPED ov;
+        set_offset(ov, offset);
+        DWORD read = 0;
+        if(!ReadFile(handle_, data, static_cast<DWORD>(std::min<size_t>(n, MAXDWORD)), &read, &ov))
+        {
+            // Reading at or after the end
+            if(GetLastError() == ERROR_HANDLE_EOF)
+                return 0;
+            return last_error();
+        }
+        return read;
+    }
+    std::ptrdiff_t async_file::write_at(std::streamoff offset, char const *data, size_t n)
+    {
+        OVERLAPPED ov;
+        set_offset(ov, offset);
+        DWORD written = 0;
+        if(!WriteFile(handle_, data, static_cast<DWORD>(std::min<size_t>(n, MAXDWORD)), &written, &ov))
+            return last_error();
+        return written;
+    }
+    std::ptrdiff_t async_file::sync()
+    {
+        return FlushFileBuffers(handle_) ? 0 : last_error();
+    }
+
+} // namespace nowide
+} // namespace boost
+
+#endif
@@ -0,0 +1,34 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_NOWIDE_SOURCE
+#include <boost/nowide/copy_file.hpp>
+
+#ifdef BOOST_WINDOWS
+
+#include <boost/nowide/stackstring.hpp>
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+
+namespace boost {
+namespace nowide {
+
+    bool copy_file(char const *from, char const *to)
+    {
+        wstackstring const wfrom(from);
+        wstackstring const wto(to);
+        return CopyFileExW(wfrom.c_str(), wto.c_str(), NULL, NULL, NULL, 0) != FALSE;
+    }
+
+} // namespace nowide
+} // namespace boost
+
+#endif
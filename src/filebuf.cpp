@@ -0,0 +1,48 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_NOWIDE_SOURCE
+#include <boost/nowide/filebuf.hpp>
+
+#if BOOST_NOWIDE_USE_WIN_FSTREAM && defined(BOOST_WINDOWS)
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+
+namespace boost {
+namespace nowide {
+    namespace details {
+
+        bool set_allocation_size(void *h, std::streamoff size)
+        {
+            FILE_ALLOCATION_INFO info;
+            info.AllocationSize.QuadPart = size;
+            return SetFileInformationByHandle(h, FileAllocationInfo, &info, sizeof(info)) != FALSE;
+        }
+
+        int open_direct_fd(wchar_t const *name, int flags)
+        {
+            HANDLE const h = CreateFileW(name, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, CREATE_ALWAYS,
+                                         FILE_FLAG_NO_BUFFERING, NULL);
+            if(h == INVALID_HANDLE_VALUE)
+                return -1;
+            int const fd = _open_osfhandle(reinterpret_cast<intptr_t>(h), flags & _O_TEXT);
+            if(fd == -1)
+                CloseHandle(h);
+            return fd;
+        }
+
+    } // namespace details
+} // namespace nowide
+} // namespace boost
+
+#endif
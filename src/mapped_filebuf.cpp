@@ -0,0 +1,110 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_NOWIDE_SOURCE
+#include <boost/nowide/mapped_filebuf.hpp>
+
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+
+#include <windows.h>
+
+namespace boost {
+namespace nowide {
+    namespace details {
+
+        mapped_file::mapped_file() : file_(INVALID_HANDLE_VALUE), mapping_(0), size_(0), view_(0), view_size_(0)
+        {}
+        mapped_file::~mapped_file()
+        {
+            close();
+        }
+        bool mapped_file::is_open() const
+        {
+            return file_ != INVALID_HANDLE_VALUE;
+        }
+        bool mapped_file::open(wchar_t const *name)
+        {
+            if(is_open())
+                return false;
+            file_ = CreateFileW(name,
+                                GENERIC_READ,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                NULL,
+                                OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL,
+                                NULL);
+            if(file_ == INVALID_HANDLE_VALUE)
+                return false;
+            LARGE_INTEGER size;
+            if(GetFileType(file_) != FILE_TYPE_DISK || !GetFileSizeEx(file_, &size))
+            {
+                close();
+                return false;
+            }
+            size_ = size.QuadPart;
+            // Mappings of empty files are not allowed, but nothing will be mapped anyway
+            if(size_ > 0)
+            {
+                mapping_ = CreateFileMappingW(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+                if(!mapping_)
+                {
+                    close();
+                    return false;
+                }
+            }
+            return true;
+        }
+        bool mapped_file::close()
+        {
+            if(!is_open())
+                return true;
+            unmap();
+            bool res = true;
+            if(mapping_ && !CloseHandle(mapping_))
+                res = false;
+            if(!CloseHandle(file_))
+                res = false;
+            mapping_ = 0;
+            file_ = INVALID_HANDLE_VALUE;
+            size_ = 0;
+            return res;
+        }
+        size_t mapped_file::granularity()
+        {
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            return info.dwAllocationGranularity;
+        }
+        char const *mapped_file::map(std::streamoff offset, size_t n)
+        {
+            unmap();
+            if(!mapping_)
+                return 0;
+            ULARGE_INTEGER off;
+            off.QuadPart = static_cast<ULONGLONG>(offset);
+            void *const p = MapViewOfFile(mapping_, FILE_MAP_READ, off.HighPart, off.LowPart, n);
+            if(!p)
+                return 0;
+            view_ = p;
+            view_size_ = n;
+            return static_cast<char const *>(p);
+        }
+        void mapped_file::unmap()
+        {
+            if(view_)
+            {
+                UnmapViewOfFile(view_);
+                view_ = 0;
+                view_size_ = 0;
+            }
+        }
+
+    } // namespace details
+} // namespace nowide
+} // namespace boost
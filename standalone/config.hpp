@@ -40,6 +40,18 @@
 #  define NOWIDE_USE_WIN_FSTREAM 0
 #endif
 
+#ifndef NOWIDE_USE_FD_FILEBUF
+#  define NOWIDE_USE_FD_FILEBUF 0
+#endif
+
+#ifndef NOWIDE_USE_ASYNC_FILEBUF
+#  define NOWIDE_USE_ASYNC_FILEBUF 0
+#endif
+
+#ifndef NOWIDE_FILEBUF_BUFFER_SIZE
+#  define NOWIDE_FILEBUF_BUFFER_SIZE 8192
+#endif
+
 #endif
 ///
 // vim: tabstop=4 expandtab shiftwidth=4 softtabstop=4
@@ -5,6 +5,8 @@
 
 namespace nowide
 {
+    typedef std::int64_t int64_t;
+    typedef std::uint64_t uint64_t;
     typedef std::uint32_t uint32_t;
     typedef std::uint16_t uint16_t;
     typedef std::uint8_t uint8_t;
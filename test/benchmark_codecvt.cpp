@@ -0,0 +1,240 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#define _SILENCE_CXX17_CODECVT_HEADER_DEPRECATION_WARNING
+#include <boost/nowide/utf8_codecvt.hpp>
+#include <boost/nowide/convert.hpp>
+#include <boost/nowide/cstdio.hpp>
+#define BOOST_CHRONO_HEADER_ONLY
+#include <boost/chrono.hpp>
+#include <algorithm>
+#include <clocale>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <locale>
+#include <string>
+#include <vector>
+#ifndef BOOST_NO_CXX11_HDR_CODECVT
+#include <codecvt>
+#endif
+
+#ifdef BOOST_MSVC
+#pragma warning(disable : 4996)
+#elif defined(__GNUC__)
+// std::codecvt_utf8 is deprecated in C++17 but still the reference to compare against
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+
+namespace nw = boost::nowide;
+typedef boost::chrono::high_resolution_clock clock_type;
+
+static const size_t data_size = 16 * 1024 * 1024;
+
+struct corpus
+{
+    char const *name;
+    std::string utf8;
+};
+
+std::string make_corpus(char const *sample)
+{
+    std::string res;
+    res.reserve(data_size + 64);
+    while(res.size() < data_size)
+        res += sample;
+    return res;
+}
+
+std::vector<corpus> make_corpora()
+{
+    std::vector<corpus> res;
+    corpus c;
+    c.name = "ASCII";
+    c.utf8 = make_corpus("The quick brown fox jumps over the lazy dog. 0123456789\n");
+    res.push_back(c);
+    c.name = "Cyrillic";
+    c.utf8 = make_corpus("\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 \xD0\xBC\xD0\xB8\xD1\x80, "
+                         "\xD0\xBA\xD0\xB0\xD0\xBA \xD0\xB4\xD0\xB5\xD0\xBB\xD0\xB0?\n");
+    res.push_back(c);
+    c.name = "CJK";
+    c.utf8 = make_corpus("\xE4\xBD\xA0\xE5\xA5\xBD\xE4\xB8\x96\xE7\x95\x8C\xE3\x81\x93\xE3\x82\x93\xE3\x81\xAB\xE3\x81\xA1\xE3\x81\xAF"
+                         "\xE4\xB8\x96\xE7\x95\x8C\n");
+    res.push_back(c);
+    c.name = "Emoji";
+    c.utf8 = make_corpus("\xF0\x9F\x98\x80\xF0\x9F\x98\x81 \xF0\x9F\x91\x8D\xF0\x9F\x8E\x89 \xF0\x9D\x92\x9E\n");
+    res.push_back(c);
+    c.name = "Invalid";
+    c.utf8 = make_corpus("abc\xFF\xD0\xBF\xD1\x80\xE3\x82\xFF\xE3\x81\x82 \xC0\xAF def\n");
+    res.push_back(c);
+    return res;
+}
+
+size_t count_code_points(wchar_t const *s, size_t n)
+{
+    size_t res = 0;
+    for(size_t i = 0; i < n; i++)
+    {
+        // Don't count the second part of surrogate pairs
+        if(sizeof(wchar_t) != 2 || s[i] < 0xDC00 || s[i] > 0xDFFF)
+            res++;
+    }
+    return res;
+}
+
+double seconds_since(clock_type::time_point start)
+{
+    return boost::chrono::duration_cast<boost::chrono::microseconds>(clock_type::now() - start).count() * 1e-6;
+}
+
+void print_name(char const *what, size_t chunk_size)
+{
+    std::cout << "  " << std::setw(28) << std::left << what << std::right << " chunk ";
+    // Chunk size 0 means the whole corpus at once
+    if(chunk_size)
+        std::cout << std::setw(6) << chunk_size;
+    else
+        std::cout << "   all";
+}
+
+void report(char const *what, size_t chunk_size, size_t bytes, size_t code_points, double tm)
+{
+    print_name(what, chunk_size);
+    std::cout << " ";
+    if(tm <= 0)
+        tm = 1e-6;
+    std::cout << std::fixed << std::setprecision(1) << std::setw(9) << (bytes / 1024.0 / 1024 / tm) << " MB/s " << std::setw(9)
+              << (code_points / 1e6 / tm) << " Mcp/s" << std::endl;
+}
+
+void report_failure(char const *what, size_t chunk_size)
+{
+    print_name(what, chunk_size);
+    std::cout << "    conversion failed" << std::endl;
+}
+
+void write_file(char const *file, std::string const &data)
+{
+    std::ofstream f(file, std::ios::binary);
+    f.write(data.c_str(), data.size());
+}
+
+void test_read(char const *file, std::locale const &l, char const *what, corpus const &c, size_t expected_code_points)
+{
+    for(size_t chunk_size = 64; chunk_size <= 16384; chunk_size *= 16)
+    {
+        std::vector<wchar_t> buf(chunk_size);
+        std::wifstream f;
+        f.imbue(l);
+        f.open(file, std::ios::binary);
+        size_t code_points = 0;
+        clock_type::time_point start = clock_type::now();
+        while(f.read(&buf[0], chunk_size) || f.gcount() > 0)
+        {
+            code_points += count_code_points(&buf[0], static_cast<size_t>(f.gcount()));
+            if(!f)
+                break;
+        }
+        double const tm = seconds_since(start);
+        if(f.bad() || code_points != expected_code_points)
+            report_failure(what, chunk_size);
+        else
+            report(what, chunk_size, c.utf8.size(), code_points, tm);
+    }
+}
+
+void test_write(char const *file, std::locale const &l, char const *what, std::wstring const &wide, size_t code_points)
+{
+    for(size_t chunk_size = 64; chunk_size <= 16384; chunk_size *= 16)
+    {
+        std::wofstream f;
+        f.imbue(l);
+        f.open(file, std::ios::binary);
+        clock_type::time_point start = clock_type::now();
+        for(size_t pos = 0; pos < wide.size() && f; pos += chunk_size)
+            f.write(wide.c_str() + pos, std::min(chunk_size, wide.size() - pos));
+        f.flush();
+        double const tm = seconds_since(start);
+        std::streamoff const bytes = f.tellp();
+        if(!f || bytes <= 0)
+            report_failure(what, chunk_size);
+        else
+            report(what, chunk_size, static_cast<size_t>(bytes), code_points, tm);
+    }
+}
+
+void test_kernels(corpus const &c, size_t expected_code_points)
+{
+    std::vector<wchar_t> buf(c.utf8.size() + 1);
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        char const *from_next;
+        wchar_t *to_next;
+        clock_type::time_point start = clock_type::now();
+        char const *const end = c.utf8.c_str() + c.utf8.size();
+        std::codecvt_base::result const res = nw::utf8_codecvt<wchar_t>::convert_in(
+          mb, c.utf8.c_str(), end, from_next, &buf[0], &buf[0] + buf.size(), to_next);
+        double const tm = seconds_since(start);
+        if(res != std::codecvt_base::ok || from_next != end
+           || count_code_points(&buf[0], static_cast<size_t>(to_next - &buf[0])) != expected_code_points)
+            report_failure("utf8_codecvt::convert_in", 0);
+        else
+            report("utf8_codecvt::convert_in", 0, c.utf8.size(), expected_code_points, tm);
+    }
+    {
+        clock_type::time_point start = clock_type::now();
+        size_t const n = std::mbstowcs(&buf[0], c.utf8.c_str(), buf.size());
+        double const tm = seconds_since(start);
+        if(n == static_cast<size_t>(-1))
+            report_failure("mbstowcs", 0);
+        else
+            report("mbstowcs", 0, c.utf8.size(), n, tm);
+    }
+}
+
+void test_corpus(char const *file, corpus const &c)
+{
+    std::cout << c.name << ":" << std::endl;
+    std::wstring const wide = nw::widen(c.utf8);
+    size_t const code_points = count_code_points(wide.c_str(), wide.size());
+
+    std::locale const nowide_locale(std::locale::classic(), new nw::utf8_codecvt<wchar_t>());
+    write_file(file, c.utf8);
+    test_read(file, nowide_locale, "read nowide::utf8_codecvt", c, code_points);
+#ifndef BOOST_NO_CXX11_HDR_CODECVT
+    std::locale const std_locale(std::locale::classic(), new std::codecvt_utf8<wchar_t>());
+    test_read(file, std_locale, "read std::codecvt_utf8", c, code_points);
+#endif
+    test_write(file, nowide_locale, "write nowide::utf8_codecvt", wide, code_points);
+#ifndef BOOST_NO_CXX11_HDR_CODECVT
+    test_write(file, std_locale, "write std::codecvt_utf8", wide, code_points);
+#endif
+    test_kernels(c, code_points);
+    nw::remove(file);
+}
+
+int main(int argc, char **argv)
+{
+    std::string filename = "perf_test_codecvt.dat";
+    if(argc == 2)
+    {
+        filename = argv[1];
+    } else if(argc != 1)
+    {
+        std::cerr << "Usage: " << argv[0] << " [test_filepath]" << std::endl;
+        return 1;
+    }
+    // mbstowcs needs a UTF-8 locale
+    if(!std::setlocale(LC_CTYPE, "C.UTF-8") && !std::setlocale(LC_CTYPE, "en_US.UTF-8") && !std::setlocale(LC_CTYPE, ".UTF8"))
+        std::cout << "Warning: No UTF-8 locale found, mbstowcs results are meaningless" << std::endl;
+    std::vector<corpus> const corpora = make_corpora();
+    for(size_t i = 0; i < corpora.size(); i++)
+        test_corpus(filename.c_str(), corpora[i]);
+    return 0;
+}
@@ -7,16 +7,27 @@
 //  http://www.boost.org/LICENSE_1_0.txt)
 //
 
+#include <boost/nowide/async_file.hpp>
 #include <boost/nowide/fstream.hpp>
+#include <boost/nowide/mapped_filebuf.hpp>
 #include <boost/nowide/cstdio.hpp>
 #include <boost/nowide/convert.hpp>
 #define BOOST_CHRONO_HEADER_ONLY
 #include <boost/chrono.hpp>
+#include <boost/cstdint.hpp>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 #include <iomanip>
 #include <vector>
 #include "test.hpp"
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
 
 #ifdef BOOST_MSVC
 #pragma warning(disable : 4996)
@@ -139,11 +150,312 @@ void test_io(const char *file, char const *type)
     std::remove(file);
 }
 
+template<typename IStream>
+void test_read_only(const char *file, char const *type)
+{
+    std::cout << "Testing read performance " << type << std::endl;
+    int data_size = 64 * 1024 * 1024;
+    {
+        std::vector<char> buf(data_size, ' ');
+        nw::ofstream f(file, std::ios::binary);
+        TEST(f);
+        f.write(&buf[0], data_size);
+    }
+    for(int block_size = 32; block_size <= 8192; block_size *= 2)
+    {
+        std::vector<char> buf(block_size);
+        IStream f(file, std::ios::binary);
+        TEST(f);
+        int size = 0;
+        boost::chrono::high_resolution_clock::time_point t1 = boost::chrono::high_resolution_clock::now();
+        while(size < data_size && f.read(&buf[0], block_size))
+            size += block_size;
+        boost::chrono::high_resolution_clock::time_point t2 = boost::chrono::high_resolution_clock::now();
+        TEST(size == data_size);
+        double tm = boost::chrono::duration_cast<boost::chrono::milliseconds>(t2 - t1).count() * 1e-3;
+        std::cout << "   read block size " << std::setw(8) << block_size << " " << std::fixed << std::setprecision(3)
+                  << (data_size / 1024.0 / 1024 / tm) << " MB/s" << std::endl;
+    }
+    std::remove(file);
+}
+
+template<typename FStream>
+void test_large_file(const char *file, char const *type)
+{
+    std::cout << "Testing large file performance " << type << std::endl;
+    // A sparse file larger than 4GB
+    const boost::int64_t data_size = 64 * 1024 * 1024;
+    const boost::int64_t start = boost::int64_t(1) << 32;
+    {
+        FStream f(file, std::ios::out | std::ios::trunc | std::ios::binary);
+        TEST(f);
+        if(!f.seekp(start + data_size) || !f.put('\0'))
+        {
+            std::cout << "  Large files not supported, skipping" << std::endl;
+            f.close();
+            std::remove(file);
+            return;
+        }
+    }
+    FStream f(file, std::ios::in | std::ios::binary);
+    TEST(f);
+    {
+        std::vector<char> buf(4096);
+        TEST(f.seekg(start));
+        boost::chrono::high_resolution_clock::time_point t1 = boost::chrono::high_resolution_clock::now();
+        for(boost::int64_t size = 0; size < data_size; size += buf.size())
+            f.read(&buf[0], buf.size());
+        boost::chrono::high_resolution_clock::time_point t2 = boost::chrono::high_resolution_clock::now();
+        TEST(f);
+        double tm = boost::chrono::duration_cast<boost::chrono::milliseconds>(t2 - t1).count() * 1e-3;
+        std::cout << "  sequential read after 4GB " << std::fixed << std::setprecision(3) << (data_size / 1024.0 / 1024 / tm)
+                  << " MB/s" << std::endl;
+    }
+    {
+        const int num_seeks = 100000;
+        char buf[16];
+        boost::uint64_t rnd = 42;
+        boost::chrono::high_resolution_clock::time_point t1 = boost::chrono::high_resolution_clock::now();
+        for(int i = 0; i < num_seeks; i++)
+        {
+            // Simple LCG for reproducible positions in the whole file
+            rnd = rnd * 6364136223846793005ULL + 1442695040888963407ULL;
+            f.seekg(static_cast<std::streamoff>((rnd >> 16) % static_cast<boost::uint64_t>(start + data_size - sizeof(buf))));
+            f.read(buf, sizeof(buf));
+        }
+        boost::chrono::high_resolution_clock::time_point t2 = boost::chrono::high_resolution_clock::now();
+        TEST(f);
+        double tm = boost::chrono::duration_cast<boost::chrono::milliseconds>(t2 - t1).count() * 1e-3;
+        std::cout << "  random seek+read          " << std::fixed << std::setprecision(3) << (num_seeks / tm / 1000)
+                  << " kseeks/s" << std::endl;
+    }
+    f.close();
+    std::remove(file);
+}
+
+#if BOOST_NOWIDE_USE_WIN_FSTREAM
+void test_write_behind(const char *file, bool write_behind)
+{
+    std::cout << "Testing write latency nowide::ofstream " << (write_behind ? "with" : "without") << " write-behind"
+              << std::endl;
+    const int data_size = 256 * 1024 * 1024;
+    const int block_size = 256;
+    std::vector<char> buf(block_size, ' ');
+    nw::ofstream f;
+    TEST(f.rdbuf()->buffer_size(1024 * 1024));
+    if(!f.rdbuf()->write_behind(write_behind))
+    {
+        std::cout << "  Not supported, skipping" << std::endl;
+        return;
+    }
+    f.open(file, std::ios::binary);
+    TEST(f);
+    typedef boost::chrono::high_resolution_clock clock;
+    clock::duration max_latency = clock::duration::zero();
+    clock::time_point const t1 = clock::now();
+    for(int size = 0; size < data_size; size += block_size)
+    {
+        clock::time_point const start = clock::now();
+        f.write(&buf[0], block_size);
+        max_latency = std::max(max_latency, clock::now() - start);
+    }
+    f.close();
+    clock::time_point const t2 = clock::now();
+    TEST(f);
+    double tm = boost::chrono::duration_cast<boost::chrono::milliseconds>(t2 - t1).count() * 1e-3;
+    std::cout << "  write block size " << std::setw(8) << block_size << " " << std::fixed << std::setprecision(3)
+              << (data_size / 1024.0 / 1024 / tm) << " MB/s, max latency "
+              << boost::chrono::duration_cast<boost::chrono::microseconds>(max_latency).count() << " us" << std::endl;
+    std::remove(file);
+}
+
+void test_direct_io(const char *file, bool direct_io)
+{
+    std::cout << "Testing sequential writes nowide::ofstream " << (direct_io ? "with" : "without") << " direct I/O"
+              << std::endl;
+    const int data_size = 1024 * 1024 * 1024;
+    const int block_size = 64 * 1024;
+    std::vector<char> buf(block_size, ' ');
+    nw::ofstream f;
+    TEST(f.rdbuf()->buffer_size(4 * 1024 * 1024));
+    if(!f.rdbuf()->direct_io(direct_io))
+    {
+        std::cout << "  Not supported, skipping" << std::endl;
+        return;
+    }
+    f.open(file, std::ios::binary);
+    if(!f)
+    {
+        std::cout << "  Not supported by the filesystem, skipping" << std::endl;
+        return;
+    }
+    typedef boost::chrono::high_resolution_clock clock;
+    clock::time_point const t1 = clock::now();
+    for(int size = 0; size < data_size; size += block_size)
+        f.write(&buf[0], block_size);
+    f.close();
+    clock::time_point const t2 = clock::now();
+    TEST(f);
+    double tm = boost::chrono::duration_cast<boost::chrono::milliseconds>(t2 - t1).count() * 1e-3;
+    std::cout << "  write block size " << std::setw(8) << block_size << " " << std::fixed << std::setprecision(3)
+              << (data_size / 1024.0 / 1024 / tm) << " MB/s" << std::endl;
+    std::remove(file);
+}
+
+/// Number of extents of the file, i.e. its fragments on disk. -1 if unknown
+int count_extents(const char *file)
+{
+#ifdef __linux__
+    int const fd = ::open(file, O_RDONLY);
+    if(fd == -1)
+        return -1;
+    fiemap map = fiemap();
+    map.fm_length = FIEMAP_MAX_OFFSET;
+    map.fm_flags = FIEMAP_FLAG_SYNC;
+    int const res = ::ioctl(fd, FS_IOC_FIEMAP, &map);
+    ::close(fd);
+    return res == 0 ? static_cast<int>(map.fm_mapped_extents) : -1;
+#else
+    (void)file;
+    return -1;
+#endif
+}
+
+void test_reserve(const char *file, bool reserve)
+{
+    std::cout << "Testing concurrently written files nowide::ofstream " << (reserve ? "with" : "without")
+              << " preallocation" << std::endl;
+    const boost::uint64_t data_size = boost::uint64_t(2) * 1024 * 1024 * 1024;
+    const int block_size = 64 * 1024;
+    std::vector<char> buf(block_size, ' ');
+    std::string const file2 = std::string(file) + ".2";
+    nw::ofstream f1(file, std::ios::binary);
+    nw::ofstream f2(file2, std::ios::binary);
+    TEST(f1 && f2);
+    typedef boost::chrono::high_resolution_clock clock;
+    clock::time_point const t1 = clock::now();
+    if(reserve && !(f1.reserve(data_size) && f2.reserve(data_size)))
+    {
+        std::cout << "  Not supported, skipping" << std::endl;
+        return;
+    }
+    // Growing both files at the same time interleaves their blocks unless they were preallocated
+    for(boost::uint64_t size = 0; size < data_size; size += block_size)
+    {
+        f1.write(&buf[0], block_size);
+        f2.write(&buf[0], block_size);
+    }
+    f1.close();
+    f2.close();
+    clock::time_point const t2 = clock::now();
+    TEST(f1 && f2);
+    double tm = boost::chrono::duration_cast<boost::chrono::milliseconds>(t2 - t1).count() * 1e-3;
+    std::cout << "  write 2 x " << (data_size >> 20) << " MB " << std::fixed << std::setprecision(3)
+              << (2 * data_size / 1024.0 / 1024 / tm) << " MB/s, extents " << count_extents(file) << " + "
+              << count_extents(file2.c_str()) << std::endl;
+    std::remove(file);
+    std::remove(file2.c_str());
+}
+#endif
+
+#if BOOST_NOWIDE_HAS_ASYNC_FILE
+/// Remove the files from the OS cache, if supported, so they are read from the storage device
+void drop_from_cache(std::vector<std::string> const &names)
+{
+#ifdef POSIX_FADV_DONTNEED
+    for(size_t i = 0; i < names.size(); i++)
+    {
+        nw::async_file f(names[i].c_str());
+        ::posix_fadvise(f.native_handle(), 0, 0, POSIX_FADV_DONTNEED);
+    }
+#else
+    (void)names;
+#endif
+}
+
+void test_small_files(const char *file)
+{
+    std::cout << "Testing reading many small files" << std::endl;
+    const int num_files = 2000;
+    const int file_size = 16 * 1024;
+    std::vector<char> data(file_size, 'x');
+    std::vector<std::string> names;
+    for(int i = 0; i < num_files; i++)
+    {
+        names.push_back(file + ("." + std::to_string(i)));
+        nw::async_file f(names.back().c_str(), std::ios::out);
+        TEST(f.write_at(0, &data[0], file_size) == file_size);
+        // Written pages can't be dropped from the cache
+        TEST(f.sync() == 0);
+    }
+    std::vector<char> buf(static_cast<size_t>(num_files) * file_size);
+    typedef boost::chrono::high_resolution_clock clock;
+    {
+        drop_from_cache(names);
+        clock::time_point const t1 = clock::now();
+        for(int i = 0; i < num_files; i++)
+        {
+            nw::ifstream f(names[i], std::ios::binary);
+            f.read(&buf[static_cast<size_t>(i) * file_size], file_size);
+            TEST(f);
+        }
+        clock::time_point const t2 = clock::now();
+        double tm = boost::chrono::duration_cast<boost::chrono::microseconds>(t2 - t1).count() * 1e-6;
+        std::cout << "  nowide::ifstream                " << std::fixed << std::setprecision(3) << (num_files / tm)
+                  << " files/s" << std::endl;
+    }
+    for(int use_io_uring = 0; use_io_uring < 2; use_io_uring++)
+    {
+        nw::async_file_service service(64, use_io_uring != 0);
+        if(use_io_uring && !service.uses_io_uring())
+            break;
+        drop_from_cache(names);
+        clock::time_point const t1 = clock::now();
+        std::vector<nw::async_file> files(num_files);
+        nw::async_batch batch;
+        int ok = 0;
+        for(int i = 0; i < num_files; i++)
+        {
+            TEST(files[i].open(names[i]));
+            batch.read(files[i], 0, &buf[static_cast<size_t>(i) * file_size], file_size, [&ok](std::ptrdiff_t res) {
+                if(res == file_size)
+                    ok++;
+            });
+        }
+        service.submit(batch);
+        service.run();
+        files.clear();
+        clock::time_point const t2 = clock::now();
+        TEST(ok == num_files);
+        double tm = boost::chrono::duration_cast<boost::chrono::microseconds>(t2 - t1).count() * 1e-6;
+        std::cout << "  nowide::async_file " << (use_io_uring ? "io_uring   " : "thread pool") << "  " << std::fixed
+                  << std::setprecision(3) << (num_files / tm) << " files/s" << std::endl;
+    }
+    for(int i = 0; i < num_files; i++)
+        std::remove(names[i].c_str());
+}
+#endif
+
 void test_perf(const char *file)
 {
     test_io<io_stdio>(file, "stdio");
     test_io<io_fstream<std::fstream> >(file, "std::fstream");
     test_io<io_fstream<nw::fstream> >(file, "nowide::fstream");
+    test_read_only<nw::ifstream>(file, "nowide::ifstream");
+    test_read_only<nw::mapped_ifstream>(file, "nowide::mapped_ifstream");
+    test_large_file<std::fstream>(file, "std::fstream");
+    test_large_file<nw::fstream>(file, "nowide::fstream");
+#if BOOST_NOWIDE_USE_WIN_FSTREAM
+    test_write_behind(file, false);
+    test_write_behind(file, true);
+    test_direct_io(file, false);
+    test_direct_io(file, true);
+    test_reserve(file, false);
+    test_reserve(file, true);
+#endif
+#if BOOST_NOWIDE_HAS_ASYNC_FILE
+    test_small_files(file);
+#endif
 }
 
 int main(int argc, char **argv)
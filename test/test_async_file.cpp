@@ -0,0 +1,267 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/nowide/async_file.hpp>
+#include <boost/nowide/cstdio.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "test.hpp"
+
+#if BOOST_NOWIDE_HAS_ASYNC_FILE
+namespace nw = boost::nowide;
+
+std::string make_content(size_t size, size_t seed)
+{
+    std::string res(size, '\0');
+    for(size_t i = 0; i < size; i++)
+        res[i] = static_cast<char>('a' + (i * 7 + seed) % 26);
+    return res;
+}
+
+/// Stores the result of an operation
+struct store_result
+{
+    std::ptrdiff_t *result;
+    void operator()(std::ptrdiff_t res) const
+    {
+        *result = res;
+    }
+};
+store_result to(std::ptrdiff_t &result)
+{
+    store_result res = {&result};
+    return res;
+}
+
+void test_open_close(const char *filepath)
+{
+    std::cout << "Open/Close" << std::endl;
+    nw::remove(filepath);
+    nw::async_file f;
+    TEST(!f.is_open());
+    TEST(!f.open(filepath));
+    TEST(!f.open(filepath, std::ios::out | std::ios::app));
+    TEST(f.open(filepath, std::ios::out | std::ios::binary));
+    TEST(f.is_open());
+    // Already open
+    TEST(!f.open(filepath, std::ios::out));
+    TEST(f.write_at(0, "Hello", 5) == 5);
+    // Writes past the end extend the file
+    TEST(f.write_at(10, "World", 5) == 5);
+    TEST(f.size() == 15);
+    TEST(f.sync() == 0);
+    char buf[20];
+    // Write only
+    TEST(f.read_at(0, buf, 5) < 0);
+    TEST(f.close());
+    TEST(!f.is_open());
+    TEST(f.close());
+
+    nw::async_file f2(filepath);
+    TEST(f2.is_open());
+    TEST(f2.read_at(0, buf, sizeof(buf)) == 15);
+    TEST(std::string(buf, 5) == "Hello");
+    TEST(std::string(buf + 10, 5) == "World");
+    TEST(f2.read_at(12, buf, sizeof(buf)) == 3);
+    TEST(f2.read_at(15, buf, sizeof(buf)) == 0);
+    // Read only
+    TEST(f2.write_at(0, "x", 1) < 0);
+    f2.close();
+    {
+        // Existing content is kept
+        nw::async_file f3(filepath, std::ios::in | std::ios::out);
+        TEST(f3.size() == 15);
+        TEST(f3.write_at(0, "J", 1) == 1);
+        TEST(f3.read_at(0, buf, 5) == 5);
+        TEST(std::string(buf, 5) == "Jello");
+    }
+    {
+        nw::async_file f3(filepath, std::ios::in | std::ios::out | std::ios::trunc);
+        TEST(f3.size() == 0);
+    }
+    TEST(nw::remove(filepath) == 0);
+}
+
+void test_read_write(const char *filepath, bool use_io_uring)
+{
+    std::cout << "Read/Write" << std::endl;
+    // Fewer slots than operations
+    nw::async_file_service service(4, use_io_uring);
+    size_t const num_blocks = 100;
+    size_t const block_size = 1000;
+    std::string const content = make_content(num_blocks * block_size, 0);
+    nw::async_file f(filepath, std::ios::in | std::ios::out | std::ios::trunc);
+    TEST(f.is_open());
+    std::vector<std::ptrdiff_t> results(num_blocks, -1);
+    nw::async_batch batch;
+    // Out of order
+    for(size_t i = 0; i < num_blocks; i++)
+    {
+        size_t const block = (i * 37) % num_blocks;
+        batch.write(f, block * block_size, content.c_str() + block * block_size, block_size, to(results[block]));
+    }
+    TEST(batch.size() == num_blocks);
+    service.submit(batch);
+    TEST(batch.empty());
+    TEST(service.pending() == num_blocks);
+    TEST(service.run() == num_blocks);
+    TEST(service.pending() == 0u);
+    for(size_t i = 0; i < num_blocks; i++)
+        TEST(results[i] == static_cast<std::ptrdiff_t>(block_size));
+    std::ptrdiff_t sync_result = -1;
+    batch.fsync(f, to(sync_result));
+    service.submit(batch);
+    TEST(service.run() == 1u);
+    TEST(sync_result == 0);
+    TEST(f.size() == static_cast<std::streamoff>(content.size()));
+
+    std::vector<char> data(content.size() + 100, '\0');
+    results.assign(num_blocks, -1);
+    for(size_t i = 0; i < num_blocks; i++)
+        batch.read(f, i * block_size, &data[i * block_size], block_size, to(results[i]));
+    // Partially and completely after the end
+    std::ptrdiff_t end_result = -1, eof_result = -1;
+    batch.read(f, content.size() - 10, &data[content.size() - 10], 100, to(end_result));
+    char eof_buf[10];
+    batch.read(f, content.size() + 10, eof_buf, sizeof(eof_buf), to(eof_result));
+    service.submit(batch);
+    TEST(service.run() == num_blocks + 2);
+    for(size_t i = 0; i < num_blocks; i++)
+        TEST(results[i] == static_cast<std::ptrdiff_t>(block_size));
+    TEST(end_result == 10);
+    TEST(eof_result == 0);
+    TEST(std::string(&data[0], content.size()) == content);
+    f.close();
+
+    // Errors are reported as negative results
+    f.open(filepath, std::ios::in);
+    std::ptrdiff_t error = 0;
+    batch.write(f, 0, "x", 1, to(error));
+    service.submit(batch);
+    service.run();
+    TEST(error < 0);
+    f.close();
+    TEST(nw::remove(filepath) == 0);
+}
+
+/// Reads a file in chunks by submitting the next read from the callback
+struct chained_reader
+{
+    nw::async_file_service *service;
+    nw::async_file *file;
+    std::vector<char> *buf;
+    std::string *result;
+    std::streamoff offset;
+
+    void operator()(std::ptrdiff_t res)
+    {
+        TEST(res >= 0);
+        if(res <= 0)
+            return;
+        result->append(&(*buf)[0], static_cast<size_t>(res));
+        chained_reader next = *this;
+        next.offset += res;
+        nw::async_batch batch;
+        batch.read(*file, next.offset, &(*buf)[0], buf->size(), next);
+        service->submit(batch);
+    }
+};
+
+void test_many_files(const char *filepath, bool use_io_uring)
+{
+    std::cout << "Many files" << std::endl;
+    size_t const num_files = 50;
+    std::vector<std::string> names, contents;
+    for(size_t i = 0; i < num_files; i++)
+    {
+        names.push_back(filepath + std::to_string(i));
+        contents.push_back(make_content(100 + i * 97, i));
+        nw::async_file f(names.back().c_str(), std::ios::out);
+        TEST(f.write_at(0, contents.back().c_str(), contents.back().size())
+             == static_cast<std::ptrdiff_t>(contents.back().size()));
+    }
+    nw::async_file_service service(16, use_io_uring);
+    std::vector<std::unique_ptr<nw::async_file>> files;
+    std::vector<std::vector<char>> buffers(num_files, std::vector<char>(1000));
+    std::vector<std::string> results(num_files);
+    nw::async_batch batch;
+    for(size_t i = 0; i < num_files; i++)
+    {
+        files.push_back(std::unique_ptr<nw::async_file>(new nw::async_file(names[i].c_str())));
+        TEST(files.back()->is_open());
+        // Read in small chunks to require several reads per file
+        buffers[i].resize(64);
+        chained_reader reader = {&service, files.back().get(), &buffers[i], &results[i], 0};
+        batch.read(*files.back(), 0, &buffers[i][0], buffers[i].size(), reader);
+    }
+    service.submit(batch);
+    // Poll until done, the operations proceed in the background
+    size_t completed = 0;
+    while(service.pending())
+        completed += service.poll();
+    TEST(completed > num_files);
+    TEST(service.run() == 0u);
+    for(size_t i = 0; i < num_files; i++)
+    {
+        TEST(results[i] == contents[i]);
+        files[i]->close();
+        TEST(nw::remove(names[i].c_str()) == 0);
+    }
+}
+
+void test_destruction(const char *filepath, bool use_io_uring)
+{
+    std::cout << "Destruction with pending operations" << std::endl;
+    std::string const content = make_content(100000, 0);
+    nw::async_file f(filepath, std::ios::out);
+    size_t calls = 0;
+    {
+        nw::async_file_service service(2, use_io_uring);
+        nw::async_batch batch;
+        for(size_t i = 0; i < 100; i++)
+            batch.write(f, i * 1000, content.c_str() + i * 1000, 1000, [&calls](std::ptrdiff_t) { calls++; });
+        service.submit(batch);
+        // Not submitted
+        batch.write(f, 0, "x", 1);
+    }
+    // All writes were done but no callback called
+    TEST(calls == 0u);
+    TEST(f.size() == static_cast<std::streamoff>(content.size()));
+    f.close();
+    TEST(nw::remove(filepath) == 0);
+}
+#endif
+
+int main(int, char **argv)
+{
+    const std::string exampleFilename = std::string(argv[0]) + "-\xd7\xa9-\xd0\xbc-\xce\xbd.txt";
+    try
+    {
+#if BOOST_NOWIDE_HAS_ASYNC_FILE
+        test_open_close(exampleFilename.c_str());
+        for(int use_io_uring = 1; use_io_uring >= 0; use_io_uring--)
+        {
+            nw::async_file_service service(1, use_io_uring != 0);
+            std::cout << "Using " << (service.uses_io_uring() ? "io_uring" : "thread pool") << std::endl;
+            TEST(use_io_uring || !service.uses_io_uring());
+            test_read_write(exampleFilename.c_str(), use_io_uring != 0);
+            test_many_files(exampleFilename.c_str(), use_io_uring != 0);
+            test_destruction(exampleFilename.c_str(), use_io_uring != 0);
+        }
+#else
+        std::cout << "Skipped, requires C++11 threads" << std::endl;
+#endif
+    } catch(std::exception const &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Ok" << std::endl;
+    return 0;
+}
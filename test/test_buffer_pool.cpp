@@ -0,0 +1,204 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/nowide/buffer_pool.hpp>
+#include <iostream>
+#include <vector>
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE && !defined(BOOST_NO_CXX11_HDR_THREAD)
+#include <atomic>
+#include <thread>
+#endif
+#include "test.hpp"
+
+namespace nw = boost::nowide;
+
+bool is_aligned(char const *p)
+{
+    return reinterpret_cast<size_t>(p) % nw::buffer_pool::alignment == 0;
+}
+
+void test_reuse()
+{
+    std::cout << "Reuse" << std::endl;
+    nw::buffer_pool pool(1024, 2);
+    TEST(pool.buffer_size() == 1024);
+    char *p1 = pool.allocate(1024);
+    TEST(is_aligned(p1));
+    // Writable
+    p1[0] = p1[1023] = 'x';
+    pool.deallocate(p1, 1024);
+    char *p2 = pool.allocate(1024);
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+    TEST(p2 == p1);
+    TEST(pool.hits() == 1u);
+    TEST(pool.misses() == 1u);
+#endif
+    // Smaller sizes are rounded up, larger ones are not pooled
+    char *p3 = pool.allocate(100);
+    TEST(is_aligned(p3));
+    pool.deallocate(p3, 100);
+    char *p4 = pool.allocate(2048);
+    TEST(is_aligned(p4));
+    pool.deallocate(p4, 2048);
+    p4 = pool.allocate(2048);
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+    TEST(pool.hits() == 1u);
+#endif
+    pool.deallocate(p4, 2048);
+    // More buffers than fit into the thread cache and shared slots go to the heap
+    std::vector<char *> buffers(10);
+    for(size_t i = 0; i < buffers.size(); i++)
+        buffers[i] = pool.allocate(1024);
+    for(size_t i = 0; i < buffers.size(); i++)
+        pool.deallocate(buffers[i], 1024);
+    size_t const hits = pool.hits();
+    for(size_t i = 0; i < buffers.size(); i++)
+        buffers[i] = pool.allocate(1024);
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+    // 4 from the thread cache and 2 from the shared slots
+    TEST(pool.hits() - hits == 6u);
+#else
+    TEST(pool.hits() == hits);
+#endif
+    for(size_t i = 0; i < buffers.size(); i++)
+        pool.deallocate(buffers[i], 1024);
+    pool.deallocate(p2, 1024);
+}
+
+void test_heap_provider()
+{
+    std::cout << "Heap provider" << std::endl;
+    nw::heap_buffer_provider provider;
+    char *p = provider.allocate(100);
+    TEST(reinterpret_cast<size_t>(p) % nw::heap_buffer_provider::alignment == 0);
+    p[0] = p[99] = 'x';
+    provider.deallocate(p, 100);
+}
+
+void test_size_classes()
+{
+    std::cout << "Size classes" << std::endl;
+    nw::buffer_pool pool(1024, 4, 3);
+    TEST(pool.size_classes() == 3u);
+    TEST(pool.max_buffer_size() == 4096u);
+    // Each request size is pooled in its class
+    size_t const sizes[] = {1024, 2048, 3000, 4096, 100};
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        size_t const n = sizes[i];
+        char *p = pool.allocate(n);
+        TEST(is_aligned(p));
+        p[0] = p[n - 1] = 'x';
+        pool.deallocate(p, n);
+        size_t const hits = pool.hits();
+        char *p2 = pool.allocate(n);
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+        TEST(p2 == p);
+        TEST(pool.hits() == hits + 1);
+#else
+        TEST(pool.hits() == hits);
+#endif
+        pool.deallocate(p2, n);
+    }
+    // 3000 uses the class of 4096, 100 the one of 1024
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+    TEST(pool.misses() == 3u);
+#endif
+    // Too large for the pool
+    char *p = pool.allocate(8192);
+    TEST(is_aligned(p));
+    pool.deallocate(p, 8192);
+    size_t const hits = pool.hits();
+    pool.deallocate(pool.allocate(8192), 8192);
+    TEST(pool.hits() == hits);
+}
+
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE && !defined(BOOST_NO_CXX11_HDR_THREAD)
+void use_pool(nw::buffer_pool *pool, int id)
+{
+    // More buffers than fit into the thread cache, so the shared slots are used too
+    char *buffers[6];
+    for(int i = 0; i < 1000; i++)
+    {
+        for(size_t j = 0; j < 6; j++)
+        {
+            buffers[j] = pool->allocate(pool->buffer_size());
+            buffers[j][0] = static_cast<char>(id);
+        }
+        std::this_thread::yield();
+        for(size_t j = 0; j < 6; j++)
+        {
+            TEST(buffers[j][0] == static_cast<char>(id));
+            pool->deallocate(buffers[j], pool->buffer_size());
+        }
+    }
+}
+
+void test_threads()
+{
+    std::cout << "Threads" << std::endl;
+    nw::buffer_pool pool(256, 4);
+    std::vector<std::thread> threads;
+    for(int i = 0; i < 8; i++)
+        threads.push_back(std::thread(use_pool, &pool, i));
+    for(size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    TEST(pool.hits() + pool.misses() == 8 * 6000u);
+    TEST(pool.hits() > pool.misses());
+}
+
+/// Keeps a buffer in the thread cache until done is set
+void cache_buffer(nw::buffer_pool *pool, std::atomic<bool> *cached, std::atomic<bool> *done)
+{
+    pool->deallocate(pool->allocate(pool->buffer_size()), pool->buffer_size());
+    *cached = true;
+    while(!*done)
+        std::this_thread::yield();
+}
+
+void test_destroyed_pool()
+{
+    std::cout << "Pool destroyed before thread exit" << std::endl;
+    nw::buffer_pool *pool = new nw::buffer_pool(512, 4);
+    std::atomic<bool> cached(false), done(false);
+    std::thread t(cache_buffer, pool, &cached, &done);
+    while(!cached)
+        std::this_thread::yield();
+    delete pool;
+    // Possibly at the same address, must not get the buffer of the old pool
+    nw::buffer_pool pool2(1024, 4);
+    done = true;
+    t.join();
+    char *p = pool2.allocate(1024);
+    TEST(pool2.hits() == 0u);
+    pool2.deallocate(p, 1024);
+}
+#endif
+
+int main()
+{
+    try
+    {
+        test_reuse();
+        test_size_classes();
+        test_heap_provider();
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE && !defined(BOOST_NO_CXX11_HDR_THREAD)
+        test_threads();
+        test_destroyed_pool();
+#endif
+        // The global pool starts at the default buffer size and covers larger buffers too
+        TEST(nw::buffer_pool::global().buffer_size() == BOOST_NOWIDE_FILEBUF_BUFFER_SIZE);
+        TEST(nw::buffer_pool::global().max_buffer_size() == BOOST_NOWIDE_FILEBUF_BUFFER_SIZE * 128u);
+    } catch(std::exception const &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Ok" << std::endl;
+    return 0;
+}
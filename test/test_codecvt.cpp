@@ -6,6 +6,7 @@
 //  http://www.boost.org/LICENSE_1_0.txt)
 //
 #include <boost/nowide/utf8_codecvt.hpp>
+#include <boost/nowide/convert.hpp>
 #include <locale>
 #include <vector>
 #include <iostream>
@@ -270,6 +271,227 @@ std::string codecvt_to_narrow(std::wstring const &s)
     return res;
 }
 
+void test_codecvt_ascii_runs()
+{
+    std::cout << "ASCII runs " << std::endl;
+    std::locale l(std::locale::classic(), new boost::nowide::utf8_codecvt<wchar_t>());
+    cvt_type const &cvt = std::use_facet<cvt_type>(l);
+
+    // ASCII runs of different lengths around the block size interleaved with multi-byte characters
+    std::string utf8;
+    for(int len = 0; len < 40; len++)
+    {
+        utf8 += std::string(len, static_cast<char>('a' + len % 26));
+        utf8 += (len % 2) ? "Ð¿" : "ð";
+    }
+    utf8 += std::string(33, 'z');
+    std::wstring const wide = boost::nowide::widen(utf8);
+    TEST(codecvt_to_wide(utf8) == wide);
+    TEST(codecvt_to_narrow(wide) == utf8);
+
+    // Convert with limited output space which must stop the fast path at the right spot
+    for(size_t m = 1; m <= 20; m++)
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        char const *from = utf8.c_str();
+        char const *from_end = from + utf8.size();
+        std::wstring res;
+        while(from != from_end)
+        {
+            wchar_t buf[20];
+            wchar_t *to_next = buf;
+            char const *from_next = from;
+            std::mbstate_t mb2 = mb;
+            std::codecvt_base::result r = cvt.in(mb, from, from_end, from_next, buf, buf + m, to_next);
+            TEST(r == cvt_type::ok || r == cvt_type::partial);
+            TEST(to_next > buf);
+            int const count = cvt.length(mb2, from, from_end, m);
+#ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+            TEST(count == from_next - from);
+#else
+            TEST(count == to_next - buf);
+#endif
+            res.append(buf, to_next);
+            from = from_next;
+        }
+        TEST(res == wide);
+    }
+    for(size_t m = 1; m <= 20; m++)
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        wchar_t const *from = wide.c_str();
+        wchar_t const *from_end = from + wide.size();
+        std::string res;
+        while(from != from_end)
+        {
+            char buf[24];
+            char *to_next = buf;
+            std::codecvt_base::result r = cvt.out(mb, from, from_end, from, buf, buf + m + 3, to_next);
+            TEST(r == cvt_type::ok || r == cvt_type::partial);
+            res.append(buf, to_next);
+        }
+        TEST(res == utf8);
+    }
+}
+
+void test_codecvt_surrogates()
+{
+#ifndef BOOST_NO_CXX11_CHAR16_T
+    std::cout << "Surrogate pairs " << std::endl;
+    typedef std::codecvt<char16_t, char, std::mbstate_t> cvt16_type;
+    std::locale l(std::locale::classic(), new boost::nowide::utf8_codecvt<char16_t>());
+    cvt16_type const &cvt = std::use_facet<cvt16_type>(l);
+
+    char const *utf8 = "\xf0\x9f\x98\x80\xf0\x9f\x98\x81" "a";
+    char const *utf8_end = utf8 + strlen(utf8);
+    char16_t const utf16[] = {0xD83D, 0xDE00, 0xD83D, 0xDE01, 'a'};
+    // Enough room: Both surrogates are written and the input is consumed at once
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        char16_t buf[5];
+        char const *from_next;
+        char16_t *to_next;
+        TEST(cvt.in(mb, utf8, utf8_end, from_next, buf, buf + 5, to_next) == cvt16_type::ok);
+        TEST(from_next == utf8_end);
+        TEST(to_next == buf + 5);
+        TEST(memcmp(buf, utf16, sizeof(utf16)) == 0);
+        std::mbstate_t mb2 = std::mbstate_t();
+        TEST(cvt.length(mb2, utf8, utf8_end, 5) == 9);
+        TEST(memcmp(&mb, &mb2, sizeof(mb)) == 0);
+    }
+    // Room for 3 units: Second character needs to be split
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        char16_t buf[5];
+        char const *from_next;
+        char16_t *to_next;
+        TEST(cvt.in(mb, utf8, utf8_end, from_next, buf, buf + 3, to_next) == cvt16_type::partial);
+        TEST(from_next == utf8 + 4);
+        TEST(to_next == buf + 3);
+        std::mbstate_t mb2 = std::mbstate_t();
+        TEST(cvt.length(mb2, utf8, utf8_end, 3) == 4);
+        TEST(memcmp(&mb, &mb2, sizeof(mb)) == 0);
+        TEST(cvt.in(mb, from_next, utf8_end, from_next, buf + 3, buf + 5, to_next) == cvt16_type::ok);
+        TEST(from_next == utf8_end);
+        TEST(to_next == buf + 5);
+        TEST(memcmp(buf, utf16, sizeof(utf16)) == 0);
+    }
+    // Room for single units only
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        char16_t buf[5];
+        char const *from = utf8;
+        for(int i = 0; i < 5; i++)
+        {
+            char16_t *to_next;
+            cvt.in(mb, from, utf8_end, from, buf + i, buf + i + 1, to_next);
+            TEST(to_next == buf + i + 1);
+        }
+        TEST(from == utf8_end);
+        TEST(memcmp(buf, utf16, sizeof(utf16)) == 0);
+    }
+#endif
+}
+
+void test_codecvt_non_virtual()
+{
+    std::cout << "Non-virtual conversion " << std::endl;
+    typedef boost::nowide::utf8_codecvt<wchar_t> utf8_cvt;
+    size_t const wlen = wcslen(wide_name);
+    size_t const u8len = strlen(utf8_name);
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        wchar_t buf[64];
+        char const *from_next;
+        wchar_t *to_next;
+        TEST(utf8_cvt::convert_in(mb, utf8_name, utf8_name + u8len, from_next, buf, buf + 64, to_next) == cvt_type::ok);
+        TEST(from_next == utf8_name + u8len);
+        TEST(std::wstring(buf, to_next) == wide_name);
+    }
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        char buf[64];
+        wchar_t const *from_next;
+        char *to_next;
+        TEST(utf8_cvt::convert_out(mb, wide_name, wide_name + wlen, from_next, buf, buf + 64, to_next) == cvt_type::ok);
+        TEST(from_next == wide_name + wlen);
+        TEST(std::string(buf, to_next) == utf8_name);
+    }
+}
+
+void test_validating_codecvt()
+{
+    std::cout << "Validating codecvt " << std::endl;
+    typedef std::codecvt<char, char, std::mbstate_t> cvt8_type;
+    std::locale l(std::locale::classic(), new boost::nowide::utf8_validating_codecvt<char>());
+    cvt8_type const &cvt = std::use_facet<cvt8_type>(l);
+    TEST(!cvt.always_noconv());
+
+    // Valid input is passed through unchanged, also in small pieces
+    std::string const valid = std::string("Hello ") + utf8_name + " world";
+    for(size_t m = 4; m <= 20; m++)
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        char const *from = valid.c_str();
+        char const *from_end = from + valid.size();
+        std::string res;
+        while(from != from_end)
+        {
+            char buf[20];
+            char *to_next;
+            char const *from_next;
+            std::mbstate_t mb2 = mb;
+            std::codecvt_base::result r = cvt.in(mb, from, from_end, from_next, buf, buf + m, to_next);
+            TEST(r == cvt8_type::ok || r == cvt8_type::partial);
+            TEST(to_next > buf);
+#ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+            TEST(cvt.length(mb2, from, from_end, m) == from_next - from);
+#endif
+            res.append(buf, to_next);
+            from = from_next;
+        }
+        TEST(res == valid);
+    }
+    // Incomplete sequences are not consumed
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        char const *input = "ab\xD7";
+        char buf[8];
+        char *to_next;
+        char const *from_next;
+        TEST(cvt.in(mb, input, input + 3, from_next, buf, buf + 8, to_next) == cvt8_type::partial);
+        TEST(from_next == input + 2);
+        TEST(to_next == buf + 2);
+    }
+    // Invalid sequences are replaced
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        std::string const input = "1\xFF\xE3\xFF\x84\xd7\xa9";
+        std::string const expected = "1\xEF\xBF\xBD\xEF\xBF\xBD\xEF\xBF\xBD\xd7\xa9";
+        char buf[32];
+        char *to_next;
+        char const *from_next;
+        TEST(cvt.in(mb, input.c_str(), input.c_str() + input.size(), from_next, buf, buf + 32, to_next) == cvt8_type::ok);
+        TEST(std::string(buf, to_next) == expected);
+        TEST(cvt.out(mb, input.c_str(), input.c_str() + input.size(), from_next, buf, buf + 32, to_next) == cvt8_type::ok);
+        TEST(std::string(buf, to_next) == expected);
+    }
+    // Or reported
+    {
+        std::locale l2(std::locale::classic(), new boost::nowide::utf8_validating_codecvt<char>(false));
+        cvt8_type const &cvt2 = std::use_facet<cvt8_type>(l2);
+        std::mbstate_t mb = std::mbstate_t();
+        char const *input = "ab\xFF"
+                            "cd";
+        char buf[8];
+        char *to_next;
+        char const *from_next;
+        TEST(cvt2.in(mb, input, input + 5, from_next, buf, buf + 8, to_next) == cvt8_type::error);
+        TEST(from_next == input + 2);
+        TEST(to_next == buf + 2);
+    }
+}
+
 void test_codecvt_subst()
 {
     std::cout << "Substitutions " << std::endl;
@@ -282,6 +504,10 @@ int main()
     {
         test_codecvt_conv();
         test_codecvt_err();
+        test_codecvt_ascii_runs();
+        test_codecvt_surrogates();
+        test_codecvt_non_virtual();
+        test_validating_codecvt();
         test_codecvt_subst();
 
     } catch(std::exception const &e)
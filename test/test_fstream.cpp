@@ -8,11 +8,21 @@
 //
 
 #include <boost/nowide/fstream.hpp>
+#include <boost/nowide/copy_file.hpp>
 #include <boost/nowide/cstdio.hpp>
 #include <boost/nowide/convert.hpp>
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 #include "test.hpp"
+#ifndef BOOST_WINDOWS
+#include <sys/stat.h>
+#endif
 
 #ifdef BOOST_MSVC
 #pragma warning(disable : 4996)
@@ -36,6 +46,30 @@ bool file_exists(const char *filepath)
         return false;
 }
 
+std::string read_binary(const char *filepath)
+{
+    nw::ifstream f(filepath, std::ios::binary);
+    std::string res;
+    char c;
+    while(f.get(c))
+        res += c;
+    return res;
+}
+
+std::string make_test_data(size_t size)
+{
+    std::string res(size, '\0');
+    for(size_t i = 0; i < size; i++)
+        res[i] = static_cast<char>('a' + (i * 7) % 26);
+    return res;
+}
+
+void write_binary(const char *filepath, const std::string &data)
+{
+    nw::ofstream f(filepath, std::ios::binary);
+    TEST(f.write(data.c_str(), data.size()));
+}
+
 template<size_t N>
 bool file_contents_equal(const char *filepath, const char (&contents)[N], bool binary_mode = false)
 {
@@ -175,6 +209,183 @@ void test_flush(const char *filepath)
     }
 }
 
+template<typename FStream>
+void test_large_reads_writes(const char *filepath)
+{
+    // Mix of writes/reads smaller and larger than the buffer
+    const size_t sizes[] = {1, 7, BUFSIZ - 1, BUFSIZ, 3, BUFSIZ + 1, 5 * BUFSIZ + 3, 2, 64 * 1024};
+    const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    std::string expected;
+    for(size_t i = 0; i < num_sizes; i++)
+    {
+        for(size_t j = 0; j < sizes[i]; j++)
+            expected += static_cast<char>('a' + (i + j) % 26);
+    }
+    for(int bufSize = -1; bufSize <= 16; bufSize += 8)
+    {
+        std::cout << "Buffer size = " << bufSize << std::endl;
+        std::vector<char> buf(16);
+        {
+            FStream f;
+            if(bufSize >= 0)
+                f.rdbuf()->pubsetbuf((bufSize == 0) ? NULL : &buf[0], bufSize);
+            f.open(filepath, std::ios::out | std::ios::trunc | std::ios::binary);
+            TEST(f);
+            size_t pos = 0;
+            for(size_t i = 0; i < num_sizes; i++)
+            {
+                TEST(f.write(expected.c_str() + pos, sizes[i]));
+                pos += sizes[i];
+            }
+        }
+        {
+            FStream f;
+            if(bufSize >= 0)
+                f.rdbuf()->pubsetbuf((bufSize == 0) ? NULL : &buf[0], bufSize);
+            f.open(filepath, std::ios::in | std::ios::binary);
+            TEST(f);
+            std::string content(expected.size(), '\0');
+            size_t pos = 0;
+            // Read in reverse order of sizes to get different alignments
+            for(size_t i = num_sizes; i > 0; i--)
+            {
+                TEST(f.read(&content[pos], sizes[i - 1]));
+                TEST(f.gcount() == static_cast<std::streamsize>(sizes[i - 1]));
+                pos += sizes[i - 1];
+            }
+            TEST(content == expected);
+            TEST(f.get() == EOF);
+        }
+        // Interleave large reads and writes on the same stream
+        {
+            FStream f;
+            if(bufSize >= 0)
+                f.rdbuf()->pubsetbuf((bufSize == 0) ? NULL : &buf[0], bufSize);
+            f.open(filepath, std::ios::in | std::ios::out | std::ios::binary);
+            TEST(f);
+            std::string content(BUFSIZ * 2, '\0');
+            TEST(f.get() == 'a');
+            TEST(f.read(&content[0], content.size()));
+            TEST(content == expected.substr(1, content.size()));
+            TEST(f.seekp(0));
+            TEST(f.write(expected.c_str() + 10, content.size()));
+            TEST(f.seekg(1));
+            content.resize(content.size() - 1);
+            TEST(f.read(&content[0], content.size()));
+            TEST(content == expected.substr(11, content.size()));
+        }
+        TEST(nw::remove(filepath) == 0);
+    }
+}
+
+template<typename FStream>
+void test_seek_tell(const char *filepath)
+{
+    std::string expected(1000, '\0');
+    for(size_t i = 0; i < expected.size(); i++)
+        expected[i] = static_cast<char>('a' + i % 26);
+    for(int bufSize = -1; bufSize <= 16; bufSize += 8)
+    {
+        std::cout << "Buffer size = " << bufSize << std::endl;
+        std::vector<char> buf(16);
+        FStream f;
+        if(bufSize >= 0)
+            f.rdbuf()->pubsetbuf((bufSize == 0) ? NULL : &buf[0], bufSize);
+        f.open(filepath, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+        TEST(f);
+        TEST(f.tellp() == std::streampos(0));
+        TEST(f.write(expected.c_str(), expected.size()));
+        TEST(f.tellp() == std::streampos(expected.size()));
+        TEST(f.seekg(0));
+        TEST(f.tellg() == std::streampos(0));
+        // Sequential reads with a tell after each
+        for(size_t i = 0; i < 40; i++)
+        {
+            TEST(f.get() == expected[i]);
+            TEST(f.tellg() == std::streampos(i + 1));
+        }
+        // Short seeks back and forth
+        TEST(f.seekg(-5, std::ios::cur));
+        TEST(f.tellg() == std::streampos(35));
+        TEST(f.get() == expected[35]);
+        TEST(f.seekg(30));
+        TEST(f.get() == expected[30]);
+        TEST(f.seekg(3, std::ios::cur));
+        TEST(f.get() == expected[34]);
+        TEST(f.seekg(500));
+        TEST(f.get() == expected[500]);
+        TEST(f.seekg(-10, std::ios::end));
+        TEST(f.tellg() == std::streampos(expected.size() - 10));
+        TEST(f.get() == expected[expected.size() - 10]);
+        // Switching from reading to writing after a tell
+        TEST(f.seekg(100));
+        TEST(f.get() == expected[100]);
+        TEST(f.tellg() == std::streampos(101));
+        TEST(f.seekp(0, std::ios::cur));
+        TEST(f.put('X'));
+        expected[101] = 'X';
+        TEST(f.tellp() == std::streampos(102));
+        // Switching from writing to reading after a tell
+        TEST(f.seekg(0, std::ios::cur));
+        TEST(f.get() == expected[102]);
+        TEST(f.seekg(101));
+        TEST(f.get() == 'X');
+        // Reading all
+        TEST(f.seekg(0));
+        std::string content(expected.size(), '\0');
+        TEST(f.read(&content[0], content.size()));
+        TEST(content == expected);
+        TEST(f.tellg() == std::streampos(expected.size()));
+        f.close();
+        TEST(nw::remove(filepath) == 0);
+        expected[101] = static_cast<char>('a' + 101 % 26);
+    }
+}
+
+template<typename FStream>
+void test_large_file(const char *filepath)
+{
+    // Beyond 4GB so neither 32 bit signed nor unsigned offsets work. The file is sparse where supported
+    const std::streamoff large_pos = (std::streamoff(1) << 32) + 42;
+    {
+        FStream f(filepath, std::ios::out | std::ios::trunc | std::ios::binary);
+        TEST(f);
+        if(!f.seekp(large_pos))
+        {
+            std::cout << "Large files not supported, skipping" << std::endl;
+            f.close();
+            nw::remove(filepath);
+            return;
+        }
+        TEST(f.tellp() == std::streampos(large_pos));
+        TEST(f.write("Hello", 5));
+        TEST(f.tellp() == std::streampos(large_pos + 5));
+    }
+    {
+        FStream f(filepath, std::ios::in | std::ios::out | std::ios::binary);
+        TEST(f);
+        TEST(f.seekg(0, std::ios::end));
+        TEST(f.tellg() == std::streampos(large_pos + 5));
+        TEST(f.seekg(large_pos + 1));
+        TEST(f.get() == 'e');
+        TEST(f.tellg() == std::streampos(large_pos + 2));
+        // Relative seeks larger than 32 bit
+        TEST(f.seekg(-large_pos, std::ios::cur));
+        TEST(f.tellg() == std::streampos(2));
+        TEST(f.get() == 0);
+        TEST(f.seekg(large_pos, std::ios::cur));
+        TEST(f.get() == 'l');
+        TEST(f.seekp(-2, std::ios::end));
+        TEST(f.put('L'));
+        TEST(f.seekg(large_pos));
+        std::string content(5, '\0');
+        TEST(f.read(&content[0], content.size()));
+        TEST(content == "HelLo");
+        TEST(f.get() == EOF);
+    }
+    TEST(nw::remove(filepath) == 0);
+}
+
 void test_ofstream_creates_file(const char *filename)
 {
     nw::remove(filename);
@@ -431,6 +642,1024 @@ void test_fstream(const char *filename)
     TEST(nw::remove(filename) == 0);
 }
 
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+template<typename OFStream>
+OFStream make_ofstream(const char *filepath)
+{
+    OFStream f(filepath, std::ios::binary);
+    TEST(f);
+    TEST(f << "Hello");
+    return f;
+}
+
+template<typename FileBuf, typename IFStream, typename OFStream>
+void test_move_swap(const char *filepath, const char *filepath2)
+{
+    {
+        FileBuf buf;
+        TEST(buf.open(filepath, std::ios::out | std::ios::binary));
+        TEST(buf.sputn("Hello", 5) == 5);
+        FileBuf buf2(std::move(buf));
+        TEST(!buf.is_open());
+        TEST(buf2.is_open());
+        TEST(buf2.sputn(" World", 6) == 6);
+        // Move assignment closes the target
+        TEST(buf.open(filepath2, std::ios::out | std::ios::binary));
+        TEST(buf.sputn("Foo", 3) == 3);
+        buf = std::move(buf2);
+        TEST(buf.is_open());
+        TEST(!buf2.is_open());
+        TEST(buf.sputc('!') == '!');
+        TEST(buf.close());
+    }
+    TEST(file_contents_equal(filepath, "Hello World!", true));
+    TEST(file_contents_equal(filepath2, "Foo", true));
+    {
+        // Unbuffered, so the read char is held inside the filebuf
+        FileBuf buf, buf2;
+        buf.pubsetbuf(NULL, 0);
+        TEST(buf.open(filepath, std::ios::in | std::ios::binary));
+        TEST(buf2.open(filepath2, std::ios::in | std::ios::binary));
+        TEST(buf.sbumpc() == 'H');
+        TEST(buf.sgetc() == 'e');
+        TEST(buf2.sgetc() == 'F');
+        swap(buf, buf2);
+        TEST(buf.sbumpc() == 'F');
+        TEST(buf2.sbumpc() == 'e');
+        TEST(buf2.sbumpc() == 'l');
+        TEST(buf.sbumpc() == 'o');
+    }
+    {
+        OFStream f = make_ofstream<OFStream>(filepath);
+        TEST(f.is_open());
+        TEST(f << " World");
+        OFStream f2;
+        f2 = std::move(f);
+        TEST(!f.is_open());
+        TEST(f2 << '!');
+        f2.close();
+        TEST(f2);
+    }
+    TEST(file_contents_equal(filepath, "Hello World!", true));
+    {
+        IFStream f(filepath, std::ios::binary);
+        IFStream f2(filepath2, std::ios::binary);
+        TEST(f.get() == 'H');
+        TEST(f2.get() == 'F');
+        f.swap(f2);
+        TEST(f.get() == 'o');
+        TEST(f2.get() == 'e');
+        using std::swap;
+        swap(f, f2);
+        TEST(f.get() == 'l');
+        TEST(f2.get() == 'o');
+        IFStream f3(std::move(f2));
+        TEST(f3.is_open());
+        TEST(f3.get() == EOF);
+        TEST(f3.eof());
+    }
+    TEST(nw::remove(filepath) == 0);
+    TEST(nw::remove(filepath2) == 0);
+}
+#endif
+
+#if BOOST_NOWIDE_USE_WIN_FSTREAM
+void test_buffer_size(const char *filepath)
+{
+    size_t const default_size = nw::filebuf::default_buffer_size();
+    TEST(default_size == BOOST_NOWIDE_FILEBUF_BUFFER_SIZE);
+    {
+        nw::filebuf buf;
+        TEST(buf.buffer_size() == default_size);
+    }
+    nw::filebuf::default_buffer_size(100);
+    {
+        nw::filebuf buf;
+        TEST(buf.buffer_size() == 100);
+    }
+    nw::filebuf::default_buffer_size(default_size);
+
+    std::string expected(64 * 1024, '\0');
+    for(size_t i = 0; i < expected.size(); i++)
+        expected[i] = static_cast<char>('a' + i % 26);
+    {
+        nw::ofstream f;
+        TEST(f.rdbuf()->buffer_size(16));
+        f.rdbuf()->adaptive_buffer(256);
+        f.open(filepath, std::ios::out | std::ios::trunc | std::ios::binary);
+        TEST(f);
+        // Sequential writes grow the buffer up to the limit
+        for(size_t i = 0; i < expected.size(); i++)
+            TEST(f.put(expected[i]));
+        TEST(f.rdbuf()->buffer_size() == 256);
+        // Not possible during I/O
+        TEST(!f.rdbuf()->buffer_size(32));
+    }
+    {
+        nw::fstream f;
+        f.open(filepath, std::ios::in | std::ios::out | std::ios::binary);
+        TEST(f);
+        TEST(f.rdbuf()->buffer_size(16));
+        f.rdbuf()->adaptive_buffer(1024);
+        std::string content(expected.size(), '\0');
+        for(size_t i = 0; i < content.size(); i++)
+            content[i] = static_cast<char>(f.get());
+        TEST(content == expected);
+        TEST(f.rdbuf()->buffer_size() == 1024);
+        // Random access shrinks it again
+        for(size_t i = 0; i < 10; i++)
+        {
+            size_t const pos = (i * 7919) % expected.size();
+            TEST(f.seekg(pos));
+            TEST(f.get() == expected[pos]);
+        }
+        TEST(f.rdbuf()->buffer_size() == 16);
+        // Same with writes
+        for(size_t i = 0; i < 10; i++)
+        {
+            size_t const pos = (i * 7919) % expected.size();
+            TEST(f.seekp(pos));
+            TEST(f.put('A'));
+            expected[pos] = 'A';
+        }
+        TEST(f.seekg(0));
+        for(size_t i = 0; i < content.size(); i++)
+            content[i] = static_cast<char>(f.get());
+        TEST(content == expected);
+    }
+    TEST(nw::remove(filepath) == 0);
+}
+
+void test_write_behind(const char *filepath)
+{
+    if(!nw::filebuf().write_behind(true))
+    {
+        std::cout << "Write-behind not supported, skipping" << std::endl;
+        return;
+    }
+    std::string expected;
+    for(size_t i = 0; i < 100000; i++)
+        expected += static_cast<char>('a' + i % 26);
+    {
+        nw::fstream f;
+        TEST(f.rdbuf()->buffer_size(64));
+        TEST(f.rdbuf()->write_behind(true));
+        f.open(filepath, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+        TEST(f);
+        // Not possible during I/O
+        TEST(f.put(expected[0]));
+        TEST(!f.rdbuf()->write_behind(false));
+        // Mix of single chars, small and large writes
+        size_t pos = 1;
+        for(size_t len = 1; pos < expected.size(); len = (len * 3) % 1000 + 1)
+        {
+            len = std::min(len, expected.size() - pos);
+            if(len == 1)
+                TEST(f.put(expected[pos]));
+            else
+                TEST(f.write(expected.c_str() + pos, len));
+            pos += len;
+            TEST(f.tellp() == std::streampos(pos));
+        }
+        TEST(f.seekp(10));
+        TEST(f.put('X'));
+        expected[10] = 'X';
+        // Read after write waits for the background writer
+        TEST(f.seekg(0));
+        std::string content(expected.size(), '\0');
+        TEST(f.read(&content[0], content.size()));
+        TEST(content == expected);
+        TEST(f.seekp(0, std::ios::end));
+        TEST(f.write("end", 3));
+        expected += "end";
+    }
+    {
+        nw::ifstream f(filepath, std::ios::binary);
+        std::string content(expected.size(), '\0');
+        TEST(f.read(&content[0], content.size()));
+        TEST(content == expected);
+        TEST(f.get() == EOF);
+    }
+    TEST(nw::remove(filepath) == 0);
+    {
+        // More files than worker threads, written and read back interleaved
+        std::vector<std::string> names;
+        for(size_t i = 0; i < 20; i++)
+            names.push_back(filepath + std::string(1, static_cast<char>('a' + i)));
+        {
+            std::vector<nw::fstream *> files;
+            for(size_t i = 0; i < names.size(); i++)
+            {
+                files.push_back(new nw::fstream);
+                TEST(files.back()->rdbuf()->buffer_size(64));
+                TEST(files.back()->rdbuf()->write_behind(true));
+                TEST(files.back()->rdbuf()->read_ahead(true));
+                files.back()->open(names[i].c_str(), std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+                TEST(*files.back());
+            }
+            for(size_t pos = 0; pos < 10000; pos += 100)
+            {
+                for(size_t i = 0; i < files.size(); i++)
+                    TEST(files[i]->write(expected.c_str() + pos + i, 100));
+            }
+            for(size_t i = 0; i < files.size(); i++)
+                TEST(files[i]->seekg(0));
+            std::string content(100, '\0');
+            for(size_t pos = 0; pos < 10000; pos += 100)
+            {
+                for(size_t i = 0; i < files.size(); i++)
+                {
+                    TEST(files[i]->read(&content[0], content.size()));
+                    TEST(content == expected.substr(pos + i, 100));
+                }
+            }
+            for(size_t i = 0; i < files.size(); i++)
+                delete files[i];
+        }
+        for(size_t i = 0; i < names.size(); i++)
+            TEST(nw::remove(names[i].c_str()) == 0);
+    }
+#ifndef BOOST_WINDOWS
+    // Errors are reported on sync or close
+    if(file_exists("/dev/full"))
+    {
+        nw::ofstream f;
+        TEST(f.rdbuf()->buffer_size(64));
+        TEST(f.rdbuf()->write_behind(true));
+        f.open("/dev/full", std::ios::out | std::ios::binary);
+        TEST(f);
+        for(size_t i = 0; i < 1000 && f; i++)
+            f.put('a');
+        f.flush();
+        TEST(!f);
+        f.clear();
+        f.put('a');
+        f.close();
+        TEST(!f);
+    }
+#endif
+}
+
+void test_read_ahead(const char *filepath)
+{
+    std::string expected;
+    for(size_t i = 0; i < 100000; i++)
+        expected += static_cast<char>('a' + i % 26);
+    {
+        nw::ofstream f(filepath, std::ios::binary);
+        TEST(f.write(expected.c_str(), expected.size()));
+    }
+    const unsigned hints[] = {nw::access_normal,
+                              nw::access_sequential | nw::access_will_need,
+                              nw::access_random,
+                              nw::access_sequential | nw::access_no_reuse};
+    for(size_t i = 0; i < sizeof(hints) / sizeof(hints[0]); i++)
+    {
+        nw::fstream f;
+        f.rdbuf()->access_hints(hints[i]);
+        TEST(f.rdbuf()->access_hints() == hints[i]);
+        TEST(f.rdbuf()->buffer_size(64));
+        if(!f.rdbuf()->read_ahead(true))
+            std::cout << "Read-ahead not supported" << std::endl;
+        f.open(filepath, std::ios::in | std::ios::out | std::ios::binary);
+        TEST(f);
+        // Sequential reads of different sizes
+        std::string content(expected.size(), '\0');
+        size_t pos = 0;
+        for(size_t len = 1; pos < content.size(); len = (len * 3) % 1000 + 1)
+        {
+            len = std::min(len, content.size() - pos);
+            TEST(f.read(&content[pos], len));
+            pos += len;
+            TEST(f.tellg() == std::streampos(pos));
+        }
+        TEST(content == expected);
+        TEST(f.get() == EOF);
+        f.clear();
+        // Seeks discard the data read ahead
+        for(size_t j = 0; j < 20; j++)
+        {
+            size_t const seekPos = (j * 7919) % expected.size();
+            TEST(f.seekg(seekPos));
+            for(size_t k = 0; k < 200 && seekPos + k < expected.size(); k++)
+                TEST(f.get() == expected[seekPos + k]);
+        }
+        // Writing after reading
+        TEST(f.seekg(500));
+        TEST(f.get() == expected[500]);
+        TEST(f.seekp(0, std::ios::cur));
+        TEST(f.put('X'));
+        expected[501] = 'X';
+        TEST(f.seekg(0));
+        TEST(f.read(&content[0], content.size()));
+        TEST(content == expected);
+    }
+    TEST(nw::remove(filepath) == 0);
+}
+
+void test_write_iov(const char *filepath)
+{
+    std::string payload(1000, '\0');
+    for(size_t i = 0; i < payload.size(); i++)
+        payload[i] = static_cast<char>('a' + i % 26);
+    std::string expected;
+    {
+        nw::ofstream f;
+        TEST(f.rdbuf()->buffer_size(64));
+        f.open(filepath, std::ios::binary);
+        TEST(f);
+        // Buffered data goes out before the buffers
+        TEST(f << "start");
+        nw::io_buffer const record[2] = {{"header", 6}, {payload.c_str(), payload.size()}};
+        TEST(f.write_iov(record, 2));
+        expected += "start" + std::string("header") + payload;
+        // Small writes are buffered
+        nw::io_buffer const small[2] = {{"ab", 2}, {"cd", 2}};
+        TEST(f.write_iov(small, 2));
+        expected += "abcd";
+        // More buffers than gathered at once
+        std::vector<nw::io_buffer> many(40);
+        for(size_t i = 0; i < many.size(); i++)
+        {
+            many[i].data = payload.c_str() + i;
+            many[i].size = i % 7;
+            expected.append(many[i].data, many[i].size);
+        }
+        TEST(f.write_iov(&many[0], many.size()));
+        TEST(f.write_iov(0, 0));
+        TEST(f << "end");
+        expected += "end";
+        TEST(f.tellp() == std::streampos(expected.size()));
+    }
+    {
+        nw::ifstream f(filepath, std::ios::binary);
+        std::string content(expected.size() + 1, '\0');
+        f.read(&content[0], content.size());
+        TEST(static_cast<size_t>(f.gcount()) == expected.size());
+        content.resize(expected.size());
+        TEST(content == expected);
+    }
+    {
+        // Writing after reading
+        nw::fstream f(filepath, std::ios::in | std::ios::out | std::ios::binary);
+        TEST(f.rdbuf()->buffer_size(64));
+        TEST(f.get() == 's');
+        TEST(f.seekp(0, std::ios::cur));
+        nw::io_buffer const record[2] = {{"XY", 2}, {payload.c_str(), 100}};
+        TEST(f.write_iov(record, 2));
+        expected.replace(1, 2, "XY");
+        expected.replace(3, 100, payload.c_str(), 100);
+        TEST(f.seekg(0));
+        std::string content(expected.size(), '\0');
+        TEST(f.read(&content[0], content.size()));
+        TEST(content == expected);
+    }
+    {
+        nw::ifstream f(filepath);
+        nw::io_buffer const record[1] = {{payload.c_str(), payload.size()}};
+        TEST(!f.rdbuf()->write_iov(record, 1));
+    }
+#ifndef BOOST_WINDOWS
+    {
+        nw::ofstream f("/dev/full", std::ios::binary);
+        if(f)
+        {
+            nw::io_buffer const record[2] = {{"header", 6}, {payload.c_str(), payload.size()}};
+            f.rdbuf()->buffer_size(0);
+            // The stdio backend reports the error on flush
+            TEST(!f.write_iov(record, 2).flush());
+            TEST(f.bad());
+        }
+    }
+#endif
+    TEST(nw::remove(filepath) == 0);
+}
+
+struct counting_provider : nw::heap_buffer_provider
+{
+    counting_provider() : allocated(0), deallocated(0)
+    {}
+    virtual char *allocate(size_t n)
+    {
+        allocated++;
+        return nw::heap_buffer_provider::allocate(n);
+    }
+    virtual void deallocate(char *p, size_t n)
+    {
+        deallocated++;
+        nw::heap_buffer_provider::deallocate(p, n);
+    }
+    int allocated, deallocated;
+};
+
+void test_buffer_provider(const char *filepath)
+{
+    TEST(nw::filebuf::default_buffer_provider() == &nw::buffer_pool::global());
+    counting_provider provider;
+    {
+        nw::fstream f;
+        TEST(f.rdbuf()->provider(&provider));
+        TEST(f.rdbuf()->provider() == &provider);
+        f.open(filepath, std::ios::out | std::ios::trunc | std::ios::binary);
+        TEST(f);
+        // Borrowed on first I/O
+        TEST(provider.allocated == 0);
+        TEST(f << "Hello");
+        TEST(provider.allocated == 1);
+        TEST(!f.rdbuf()->provider(&nw::buffer_pool::global()));
+        // Given back on close
+        f.close();
+        TEST(provider.deallocated == 1);
+        f.open(filepath, std::ios::in | std::ios::binary);
+        std::string s;
+        TEST(f >> s);
+        TEST(s == "Hello");
+        TEST(provider.allocated == 2);
+    }
+    TEST(provider.deallocated == 2);
+    // Files opened and closed in a row reuse the buffers of the global pool
+    nw::buffer_pool &pool = nw::buffer_pool::global();
+    {
+        nw::ifstream f(filepath);
+        TEST(f.get() == 'H');
+    }
+    size_t const hits = pool.hits(), misses = pool.misses();
+    for(int i = 0; i < 10; i++)
+    {
+        nw::ifstream f(filepath);
+        TEST(f.get() == 'H');
+    }
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+    TEST(pool.hits() == hits + 10);
+    TEST(pool.misses() == misses);
+#else
+    (void)hits;
+    (void)misses;
+#endif
+    // Also with a different buffer size
+    size_t const default_size = nw::filebuf::default_buffer_size();
+    nw::filebuf::default_buffer_size(default_size * 4);
+    {
+        nw::ifstream f(filepath);
+        TEST(f.get() == 'H');
+    }
+    size_t const hits2 = pool.hits();
+    for(int i = 0; i < 10; i++)
+    {
+        nw::ifstream f(filepath);
+        TEST(f.get() == 'H');
+    }
+    nw::filebuf::default_buffer_size(default_size);
+#if BOOST_NOWIDE_BUFFER_POOL_HAS_CACHE
+    TEST(pool.hits() == hits2 + 10);
+#else
+    (void)hits2;
+#endif
+    TEST(nw::remove(filepath) == 0);
+}
+
+void test_direct_io(const char *filepath)
+{
+    std::string expected;
+    for(size_t i = 0; i < 50123; i++)
+        expected += static_cast<char>('a' + i % 26);
+    for(int write_behind = 0; write_behind < 2; write_behind++)
+    {
+        nw::ofstream f;
+        if(!f.rdbuf()->direct_io(true))
+        {
+            std::cout << "Direct I/O not supported" << std::endl;
+            TEST(!f.rdbuf()->direct_io());
+            return;
+        }
+        TEST(f.rdbuf()->direct_io());
+        TEST(f.rdbuf()->buffer_size(10000));
+        f.rdbuf()->write_behind(write_behind != 0);
+        f.open(filepath, std::ios::binary);
+        if(!f)
+        {
+            std::cout << "Direct I/O not supported by the filesystem" << std::endl;
+            return;
+        }
+        // Rounded up to whole blocks
+        TEST(f.rdbuf()->buffer_size() == 12288);
+        size_t pos = 0;
+        for(size_t len = 1; pos < expected.size(); len = (len * 7) % 20000 + 1)
+        {
+            len = std::min(len, expected.size() - pos);
+            TEST(f.write(expected.c_str() + pos, len));
+            pos += len;
+            TEST(f.tellp() == std::streampos(pos));
+            if(len % 3 == 0)
+                TEST(f.flush());
+        }
+        // Only tells
+        TEST(!f.seekp(0));
+        f.clear();
+        f.close();
+        TEST(f);
+        TEST(read_binary(filepath) == expected);
+    }
+    {
+        // Not supported for reading or appending
+        nw::fstream f;
+        TEST(f.rdbuf()->direct_io(true));
+        f.open(filepath, std::ios::in | std::ios::out | std::ios::binary);
+        TEST(!f);
+        nw::ofstream f2;
+        TEST(f2.rdbuf()->direct_io(true));
+        f2.open(filepath, std::ios::app | std::ios::binary);
+        TEST(!f2);
+        // Not while open
+        f2.rdbuf()->direct_io(false);
+        f2.clear();
+        f2.open(filepath, std::ios::app | std::ios::binary);
+        TEST(f2);
+        TEST(!f2.rdbuf()->direct_io(true));
+        // Not with a user buffer
+        char buf[16];
+        nw::filebuf f3;
+        f3.pubsetbuf(buf, sizeof(buf));
+        TEST(!f3.direct_io(true));
+    }
+    {
+        // Files shorter than a block
+        nw::ofstream f;
+        TEST(f.rdbuf()->direct_io(true));
+        f.open(filepath, std::ios::binary);
+        TEST(f << "Hello");
+        f.close();
+        TEST(f);
+        TEST(read_binary(filepath) == "Hello");
+    }
+    TEST(nw::remove(filepath) == 0);
+}
+
+void test_reserve(const char *filepath)
+{
+    std::string expected;
+    for(size_t i = 0; i < 3000; i++)
+        expected += static_cast<char>('a' + i % 26);
+    {
+        nw::ofstream f;
+        // Not open
+        TEST(!f.reserve(1000));
+        f.open(filepath, std::ios::binary);
+        if(!f.reserve(1024 * 1024))
+        {
+            std::cout << "Preallocation not supported" << std::endl;
+            f.close();
+            TEST(nw::remove(filepath) == 0);
+            return;
+        }
+        TEST(f.tellp() == std::streampos(0));
+        TEST(f.write(expected.c_str(), expected.size()));
+        // Holes before the end of the data are kept
+        TEST(f.seekp(10));
+        TEST(f.write("XY", 2));
+        f.close();
+        TEST(f);
+        expected.replace(10, 2, "XY");
+        // Cut to the end of the data
+        TEST(read_binary(filepath) == expected);
+    }
+    {
+        // Existing data is kept, also if it was not written to
+        nw::fstream f(filepath, std::ios::in | std::ios::out | std::ios::binary);
+        TEST(f);
+        TEST(f.seekp(100));
+        TEST(f.reserve(100000));
+        TEST(f.write("Hello", 5));
+        // Reserving less than the file size does nothing
+        TEST(f.reserve(10));
+        f.close();
+        TEST(f);
+        expected.replace(100, 5, "Hello");
+        TEST(read_binary(filepath) == expected);
+    }
+    for(int write_behind = 0; write_behind < 2; write_behind++)
+    {
+        nw::ofstream f;
+        f.rdbuf()->buffer_size(100);
+        f.rdbuf()->write_behind(write_behind != 0);
+        f.open(filepath, std::ios::binary);
+        TEST(f.reserve(1024 * 1024));
+        TEST(f.write(expected.c_str(), expected.size()));
+        f.close();
+        TEST(f);
+        TEST(read_binary(filepath) == expected);
+    }
+    {
+        nw::ofstream f;
+        if(f.rdbuf()->direct_io(true))
+        {
+            f.open(filepath, std::ios::binary);
+            if(f)
+            {
+                TEST(f.reserve(1024 * 1024));
+                TEST(f.write(expected.c_str(), expected.size()));
+                f.close();
+                TEST(f);
+                // Without the padding
+                TEST(read_binary(filepath) == expected);
+            }
+        }
+    }
+    {
+        // Not for reading or appending
+        nw::ifstream f(filepath);
+        TEST(!f.rdbuf()->reserve(1000));
+        nw::ofstream f2(filepath, std::ios::app | std::ios::binary);
+        TEST(!f2.reserve(1000));
+    }
+    TEST(nw::remove(filepath) == 0);
+}
+
+void test_in_avail(const char *filepath)
+{
+    std::string const data = make_test_data(50000);
+    write_binary(filepath, data);
+    {
+        nw::ifstream f(filepath, std::ios::binary);
+        // Nothing read yet
+        TEST(f.rdbuf()->in_avail() == 50000);
+        char buf[100];
+        TEST(f.read(buf, sizeof(buf)));
+        TEST(f.rdbuf()->in_avail() > 0);
+        // Outside of the buffer
+        TEST(f.seekg(20000));
+        TEST(f.rdbuf()->in_avail() == 30000);
+        // Reads everything remaining at once
+        std::string rest(static_cast<size_t>(f.rdbuf()->in_avail()), '\0');
+        TEST(f.readsome(&rest[0], static_cast<std::streamsize>(rest.size())) == 30000);
+        TEST(rest == data.substr(20000));
+        // Known to be at the end
+        TEST(f.rdbuf()->in_avail() == -1);
+        TEST(f.readsome(buf, sizeof(buf)) == 0);
+        TEST(f.eof());
+        f.clear();
+        TEST(f.seekg(0, std::ios::end));
+        TEST(f.rdbuf()->in_avail() == -1);
+        // Past the end
+        TEST(f.seekg(60000));
+        TEST(f.rdbuf()->in_avail() == -1);
+    }
+#ifndef BOOST_WINDOWS
+    if(file_exists("/dev/null"))
+    {
+        // No size, so unknown
+        nw::ifstream f("/dev/null", std::ios::binary);
+        TEST(f.rdbuf()->in_avail() == 0);
+    }
+#endif
+    for(int buffered = 0; buffered < 2; buffered++)
+    {
+        write_binary(filepath, data);
+        nw::fstream f;
+        if(!buffered)
+            f.rdbuf()->pubsetbuf(0, 0);
+        f.open(filepath, std::ios::in | std::ios::out | std::ios::binary);
+        TEST(f);
+        // Overwriting doesn't change the size, appending does. Seeking writes the buffered data
+        TEST(f.seekp(49990));
+        TEST(f.write("Hello", 5));
+        TEST(f.seekg(49000));
+        TEST(f.rdbuf()->in_avail() == 1000);
+        TEST(f.seekp(0, std::ios::end));
+        TEST(f.write("World", 5));
+        TEST(f.seekg(49000));
+        TEST(f.rdbuf()->in_avail() == 1005);
+        TEST(f.seekg(-2, std::ios::end));
+        TEST(f.rdbuf()->in_avail() == 2);
+    }
+    {
+        // Reserved space is not available
+        nw::fstream f(filepath, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+        if(f.reserve(1024 * 1024))
+        {
+            TEST(f.write("Hello", 5));
+            TEST(f.seekg(1));
+            TEST(f.rdbuf()->in_avail() == 4);
+        }
+    }
+    {
+        // Not available for reading
+        nw::ofstream f(filepath, std::ios::binary);
+        TEST(f.rdbuf()->in_avail() == 0);
+        nw::filebuf closed;
+        TEST(closed.in_avail() == 0);
+    }
+    TEST(nw::remove(filepath) == 0);
+}
+#endif
+
+void test_wide_streams(const char *filepath)
+{
+    // ASCII, Cyrillic, CJK and a surrogate pair in UTF-16
+    std::string const sample = "Hello \xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 \xE4\xBD\xA0\xE5\xA5\xBD \xF0\x9F\x98\x80\n";
+    std::string utf8;
+    // Large enough to cross buffer boundaries in the middle of sequences
+    while(utf8.size() < 100000)
+        utf8 += sample;
+    std::wstring const wide = nw::widen(utf8);
+    {
+        nw::wofstream f(filepath);
+        TEST(f);
+        TEST(f << wide.substr(0, 1000));
+        TEST(f.write(wide.c_str() + 1000, wide.size() - 1000));
+    }
+    TEST(read_binary(filepath) == utf8);
+    {
+        nw::wifstream f(filepath);
+        TEST(f);
+        std::wstring line;
+        TEST(std::getline(f, line));
+        TEST(line + L"\n" == nw::widen(sample));
+        std::wstring content = line + L"\n";
+        wchar_t c;
+        while(f.get(c))
+            content += c;
+        TEST(content == wide);
+    }
+    {
+        nw::wifstream f(filepath);
+        std::vector<wchar_t> buf(wide.size() + 1);
+        f.read(&buf[0], buf.size());
+        TEST(static_cast<size_t>(f.gcount()) == wide.size());
+        TEST(std::wstring(&buf[0], wide.size()) == wide);
+    }
+    {
+        nw::wfilebuf buf;
+        TEST(buf.open(filepath, std::ios::in));
+        wchar_t start[7];
+        TEST(buf.sgetn(start, 7) == 7);
+        TEST(std::wstring(start, 7) == wide.substr(0, 7));
+    }
+    std::cout << "Wide seek/tell" << std::endl;
+    {
+        nw::wifstream f(filepath);
+        std::vector<std::streampos> positions;
+        std::vector<size_t> indices;
+        for(size_t i = 0; i < wide.size(); i++)
+        {
+            if(i % 997 == 0)
+            {
+                positions.push_back(f.tellg());
+                indices.push_back(i);
+            }
+            TEST(f.get() == static_cast<std::wint_t>(wide[i]));
+        }
+        TEST(f.tellg() == std::streampos(utf8.size()));
+        TEST(f.get() == WEOF);
+        f.clear();
+        for(size_t i = positions.size(); i-- > 0;)
+        {
+            TEST(f.seekg(positions[i]));
+            for(size_t j = indices[i]; j < indices[i] + 10 && j < wide.size(); j++)
+                TEST(f.get() == static_cast<std::wint_t>(wide[j]));
+        }
+        // Only seeks to known positions are possible
+        TEST(f.seekg(0, std::ios::end));
+        TEST(f.tellg() == std::streampos(utf8.size()));
+        TEST(!f.seekg(-1, std::ios::cur));
+    }
+    {
+        // Switching between reading and writing
+        nw::wfstream f(filepath, std::ios::in | std::ios::out);
+        TEST(f);
+        std::wstring start(6, L'\0');
+        TEST(f.read(&start[0], start.size()));
+        TEST(start == L"Hello ");
+        TEST(f.seekp(0, std::ios::cur));
+        TEST(f << L"World");
+        TEST(f.seekg(0));
+        std::wstring line;
+        TEST(std::getline(f, line));
+        TEST(line.substr(0, 11) == L"Hello World");
+    }
+    std::cout << "Wide invalid UTF-8" << std::endl;
+    {
+        nw::ofstream f(filepath, std::ios::binary);
+        // Invalid byte, valid sequence and an incomplete sequence at the end
+        TEST(f << "a\xFF\xD0\xBF\xE4\xBD");
+    }
+    {
+        nw::wifstream f(filepath, std::ios::binary);
+        std::wstring content;
+        wchar_t c;
+        while(f.get(c))
+            content += c;
+#if BOOST_NOWIDE_USE_WIN_FSTREAM
+        TEST(content == L"a\xFFFD\x043F\xFFFD");
+#else
+        // The standard filebuf reports the incomplete sequence as an error
+        TEST(content == L"a\xFFFD\x043F");
+        TEST(f.bad());
+#endif
+    }
+    // Other character types are only converted by the own implementation
+#if BOOST_NOWIDE_USE_WIN_FSTREAM && !defined(BOOST_NO_CXX11_CHAR16_T) && !defined(BOOST_NO_CXX11_CHAR32_T)
+    std::cout << "char16_t/char32_t" << std::endl;
+    {
+        nw::basic_ofstream<char32_t> f(filepath, std::ios::binary);
+        TEST(f << U"\x043F\x1F600");
+    }
+    TEST(read_binary(filepath) == "\xD0\xBF\xF0\x9F\x98\x80");
+    {
+        nw::basic_ifstream<char32_t> f(filepath, std::ios::binary);
+        std::u32string content;
+        char32_t c;
+        while(f.get(c))
+            content += c;
+        TEST(content == U"\x043F\x1F600");
+    }
+    {
+        nw::basic_ifstream<char16_t> f(filepath, std::ios::binary);
+        std::u16string content;
+        char16_t c;
+        while(f.get(c))
+            content += c;
+        TEST(content == u"\x043F\xD83D\xDE00");
+    }
+    std::cout << "Lone high surrogate" << std::endl;
+    {
+        nw::basic_filebuf<char16_t> buf;
+        TEST(buf.open(filepath, std::ios::out | std::ios::binary));
+        TEST(buf.sputn(u"a\xD83D", 2) == 2);
+        // Neither flushed nor carried over to the next position
+        TEST(buf.pubsync() == -1);
+        TEST(buf.pubseekoff(0, std::ios::beg) == std::streampos(-1));
+        TEST(!buf.close());
+    }
+    TEST(read_binary(filepath) == "a");
+    {
+        nw::basic_ofstream<char16_t> f(filepath, std::ios::binary);
+        TEST(f << u"\xD83D");
+        f.close();
+        TEST(!f);
+    }
+    {
+        // A pair written in two parts is fine
+        nw::basic_ofstream<char16_t> f(filepath, std::ios::binary);
+        TEST(f << u"\xD83D");
+        TEST(f.rdbuf()->sputc(u'\xDE00') == 0xDE00);
+        f.close();
+        TEST(f);
+    }
+    TEST(read_binary(filepath) == "\xF0\x9F\x98\x80");
+#endif
+    TEST(nw::remove(filepath) == 0);
+}
+
+void test_copy_file(const char *filepath, const char *filepath2)
+{
+    std::string last_data;
+    for(size_t size = 0; size < 300000; size = size * 10 + 3)
+    {
+        std::string const data = make_test_data(size);
+        write_binary(filepath, data);
+        // Existing longer content is replaced
+        write_binary(filepath2, make_test_data(size + 100));
+        TEST(nw::copy_file(filepath, filepath2));
+        TEST(read_binary(filepath2) == data);
+        TEST(nw::remove(filepath2) == 0);
+        TEST(nw::copy_file(std::string(filepath), std::string(filepath2)));
+        TEST(read_binary(filepath2) == data);
+        last_data = data;
+    }
+#ifndef BOOST_WINDOWS
+    // Permissions are copied independent of the umask, also to existing files
+    TEST(::chmod(filepath, 0666) == 0);
+    TEST(::chmod(filepath2, 0600) == 0);
+    TEST(nw::copy_file(filepath, filepath2));
+    struct stat st;
+    TEST(::stat(filepath2, &st) == 0);
+    TEST((st.st_mode & 0777) == 0666);
+#endif
+    // Copying onto itself keeps the content
+    nw::copy_file(filepath, filepath);
+    TEST(read_binary(filepath) == last_data);
+    TEST(nw::remove(filepath) == 0);
+    TEST(!nw::copy_file(filepath, filepath2));
+    TEST(nw::remove(filepath2) == 0);
+}
+
+/// Returns 3 bytes and then fails to read more although data is available
+struct short_read_buf : std::streambuf
+{
+    std::streamsize xsgetn(char *s, std::streamsize n)
+    {
+        if(done)
+            return 0;
+        done = true;
+        std::memcpy(s, "abc", 3);
+        return std::min<std::streamsize>(n, 3);
+    }
+    int_type underflow()
+    {
+        return traits_type::to_int_type('x');
+    }
+    short_read_buf() : done(false)
+    {}
+    bool done;
+};
+
+void test_transfer(const char *filepath, const char *filepath2)
+{
+    std::string const data = make_test_data(200000);
+    write_binary(filepath, data);
+    {
+        nw::ifstream in(filepath, std::ios::binary);
+        nw::ofstream out(filepath2, std::ios::binary);
+        // Data already buffered in both streams
+        char buf[10];
+        TEST(in.read(buf, sizeof(buf)));
+        TEST(out.write(buf, sizeof(buf)));
+        TEST(nw::transfer(in, out, 100000) == 100000);
+        TEST(in.tellg() == std::streampos(100010));
+        TEST(out.tellp() == std::streampos(100010));
+        TEST(in.get(buf[0]));
+        TEST(out.put(buf[0]));
+        // Stops at the end of the input
+        TEST(nw::transfer(in, out, 200000) == 200000 - 100011);
+        TEST(in.eof());
+        TEST(out);
+        out.close();
+        TEST(out);
+        TEST(read_binary(filepath2) == data);
+    }
+    {
+        // Partially into the middle of an existing file
+        nw::ifstream in(filepath, std::ios::binary);
+        nw::fstream out(filepath2, std::ios::in | std::ios::out | std::ios::binary);
+        TEST(in.seekg(5));
+        TEST(out.seekp(1000));
+        TEST(nw::transfer(in, out, 50000) == 50000);
+        char c;
+        TEST(out.get(c));
+        TEST(c == data[51000]);
+        out.close();
+        TEST(out);
+        std::string expected = data;
+        expected.replace(1000, 50000, data.substr(5, 50000));
+        TEST(read_binary(filepath2) == expected);
+    }
+    {
+        // Other stream buffers
+        std::istringstream in(data.substr(0, 1000));
+        nw::ofstream out(filepath2, std::ios::binary);
+        TEST(nw::transfer(in, out, 10) == 10);
+        TEST(nw::transfer(in, out, 0) == 0);
+        TEST(nw::transfer(in, out, 2000) == 990);
+        TEST(in.eof());
+        out.close();
+        TEST(read_binary(filepath2) == data.substr(0, 1000));
+        nw::ifstream in2(filepath, std::ios::binary);
+        std::ostringstream out2;
+        TEST(nw::transfer(in2, out2, 100000) == 100000);
+        TEST(out2.str() == data.substr(0, 100000));
+    }
+    {
+        // Failed streams
+        nw::ifstream in(filepath, std::ios::binary);
+        nw::ofstream out;
+        TEST(nw::transfer(in, out, 10) == 0);
+        TEST(!out);
+        TEST(in);
+        std::istringstream in2("Hello");
+        TEST(nw::transfer(in2, out, 10) == 0);
+        TEST(in2);
+        // Failed reads are not reported as the end of the input
+        short_read_buf buf;
+        std::istream in3(&buf);
+        std::ostringstream out2;
+        TEST(nw::transfer(in3, out2, 10) == 3);
+        TEST(in3.bad());
+        TEST(!in3.eof());
+        TEST(out2);
+        TEST(out2.str() == "abc");
+    }
+#if BOOST_NOWIDE_USE_WIN_FSTREAM
+    {
+        nw::filebuf in, out;
+        TEST(in.open(filepath, std::ios::in | std::ios::binary));
+        TEST(out.open(filepath2, std::ios::out | std::ios::binary));
+        // Wrong directions or the same file
+        TEST(out.transfer(in, 10) == 0);
+        TEST(in.transfer(in, 10) == 0);
+        // Unbuffered
+        in.pubsetbuf(0, 0);
+        TEST(in.transfer(out, 10) == 10);
+        TEST(in.sbumpc() == data[10]);
+        TEST(in.transfer(out, 300000) == 200000 - 11);
+        TEST(out.close());
+        TEST(read_binary(filepath2) == data.substr(0, 10) + data.substr(11));
+    }
+#endif
+    TEST(nw::remove(filepath) == 0);
+    TEST(nw::remove(filepath2) == 0);
+}
+
 int main(int, char **argv)
 {
     const std::string exampleFilename = std::string(argv[0]) + "-\xd7\xa9-\xd0\xbc-\xce\xbd.txt";
@@ -448,6 +1677,30 @@ int main(int, char **argv)
         std::cout << "Complex IO - Test" << std::endl;
         test_with_different_buffer_sizes<nw::fstream>(exampleFilename.c_str());
 
+        std::cout << "Large reads/writes - Sanity Check" << std::endl;
+        test_large_reads_writes<std::fstream>((std::string(argv[0]) + "-bufferSize.txt").c_str());
+        std::cout << "Large reads/writes - Test" << std::endl;
+        test_large_reads_writes<nw::fstream>(exampleFilename.c_str());
+
+        std::cout << "Seek/Tell - Sanity Check" << std::endl;
+        test_seek_tell<std::fstream>((std::string(argv[0]) + "-bufferSize.txt").c_str());
+        std::cout << "Seek/Tell - Test" << std::endl;
+        test_seek_tell<nw::fstream>(exampleFilename.c_str());
+
+        std::cout << "Large file - Sanity Check" << std::endl;
+        test_large_file<std::fstream>((std::string(argv[0]) + "-bufferSize.txt").c_str());
+        std::cout << "Large file - Test" << std::endl;
+        test_large_file<nw::fstream>(exampleFilename.c_str());
+
+        // boost::filesystem streams are not movable
+#if !defined(BOOST_NO_CXX11_RVALUE_REFERENCES) && (BOOST_NOWIDE_USE_WIN_FSTREAM || !defined(BOOST_NOWIDE_USE_FILESYSTEM))
+        std::cout << "Move/Swap - Sanity Check" << std::endl;
+        test_move_swap<std::filebuf, std::ifstream, std::ofstream>((std::string(argv[0]) + "-bufferSize.txt").c_str(),
+                                                                   (std::string(argv[0]) + "-bufferSize2.txt").c_str());
+        std::cout << "Move/Swap - Test" << std::endl;
+        test_move_swap<nw::filebuf, nw::ifstream, nw::ofstream>(exampleFilename.c_str(), (exampleFilename + "2").c_str());
+#endif
+
         std::cout << "filebuf::close - Sanity Check" << std::endl;
         // Don't use chars the std stream can't properly handle
         test_close<std::filebuf>((std::string(argv[0]) + "-bufferSize.txt").c_str());
@@ -458,6 +1711,30 @@ int main(int, char **argv)
         test_flush<std::ifstream, std::ofstream>(exampleFilename.c_str());
         std::cout << "Flush - Test" << std::endl;
         test_flush<nw::ifstream, nw::ofstream>(exampleFilename.c_str());
+        std::cout << "Copy file" << std::endl;
+        test_copy_file(exampleFilename.c_str(), (exampleFilename + "2").c_str());
+        std::cout << "Transfer" << std::endl;
+        test_transfer(exampleFilename.c_str(), (exampleFilename + "2").c_str());
+#if BOOST_NOWIDE_USE_WIN_FSTREAM
+        std::cout << "Buffer size" << std::endl;
+        test_buffer_size(exampleFilename.c_str());
+        std::cout << "Write-behind" << std::endl;
+        test_write_behind(exampleFilename.c_str());
+        std::cout << "Read-ahead" << std::endl;
+        test_read_ahead(exampleFilename.c_str());
+        std::cout << "Vectored writes" << std::endl;
+        test_write_iov(exampleFilename.c_str());
+        std::cout << "Direct I/O" << std::endl;
+        test_direct_io(exampleFilename.c_str());
+        std::cout << "Preallocation" << std::endl;
+        test_reserve(exampleFilename.c_str());
+        std::cout << "in_avail" << std::endl;
+        test_in_avail(exampleFilename.c_str());
+        std::cout << "Buffer provider" << std::endl;
+        test_buffer_provider(exampleFilename.c_str());
+#endif
+        std::cout << "Wide streams" << std::endl;
+        test_wide_streams(exampleFilename.c_str());
     } catch(std::exception const &e)
     {
         std::cerr << e.what() << std::endl;
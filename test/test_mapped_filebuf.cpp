@@ -0,0 +1,195 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/nowide/mapped_filebuf.hpp>
+#include <boost/nowide/fstream.hpp>
+#include <boost/nowide/cstdio.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "test.hpp"
+
+namespace nw = boost::nowide;
+
+std::string make_content(size_t size)
+{
+    std::string res(size, '\0');
+    for(size_t i = 0; i < size; i++)
+        res[i] = static_cast<char>('a' + (i * 7 + i / 251) % 26);
+    return res;
+}
+
+void write_file(const char *filepath, std::string const &content)
+{
+    nw::ofstream f(filepath, std::ios::binary);
+    TEST(f);
+    f.write(content.c_str(), content.size());
+    TEST(f);
+}
+
+void test_open_close(const char *filepath)
+{
+    std::cout << "Open/Close" << std::endl;
+    nw::remove(filepath);
+    {
+        nw::mapped_ifstream f(filepath);
+        TEST(!f);
+        TEST(!f.is_open());
+    }
+    write_file(filepath, "Hello");
+    {
+        nw::mapped_filebuf buf;
+        TEST(!buf.open(filepath, std::ios::out));
+        TEST(!buf.open(filepath, std::ios::in | std::ios::app));
+        TEST(buf.open(filepath, std::ios::in));
+        TEST(buf.is_open());
+        TEST(buf.size() == 5);
+        // Already open
+        TEST(!buf.open(filepath, std::ios::in));
+        TEST(buf.close());
+        TEST(!buf.is_open());
+        TEST(!buf.close());
+    }
+    {
+        nw::mapped_ifstream f(filepath);
+        TEST(f);
+        std::string s;
+        TEST(f >> s);
+        TEST(s == "Hello");
+        TEST(!(f >> s));
+        TEST(f.eof());
+        f.close();
+        TEST(!f.is_open());
+    }
+    {
+        nw::mapped_ifstream f(filepath, std::ios::ate);
+        TEST(f);
+        TEST(f.tellg() == std::streampos(5));
+        TEST(f.get() == EOF);
+    }
+    write_file(filepath, "");
+    {
+        nw::mapped_ifstream f(filepath);
+        TEST(f);
+        TEST(f.rdbuf()->in_avail() == -1);
+        TEST(f.get() == EOF);
+        f.clear();
+        TEST(f.seekg(0, std::ios::end));
+        TEST(f.tellg() == std::streampos(0));
+    }
+    nw::remove(filepath);
+}
+
+void test_sequential(const char *filepath)
+{
+    std::cout << "Sequential reads" << std::endl;
+    // Use a small window to cover remapping
+    size_t const window = nw::details::mapped_file::granularity();
+    std::string const content = make_content(window * 3 + 123);
+    write_file(filepath, content);
+    {
+        nw::mapped_ifstream f;
+        f.rdbuf()->window_size(1);
+        TEST(f.rdbuf()->window_size() == window);
+        f.open(filepath);
+        TEST(f);
+        TEST(f.rdbuf()->in_avail() == static_cast<std::streamsize>(content.size()));
+        for(size_t i = 0; i < content.size(); i++)
+            TEST(f.get() == static_cast<unsigned char>(content[i]));
+        TEST(f.get() == EOF);
+    }
+    {
+        nw::mapped_ifstream f;
+        f.rdbuf()->window_size(window);
+        f.open(filepath);
+        TEST(f);
+        // Reads crossing window boundaries
+        std::vector<char> buf(1000);
+        std::string result;
+        while(f.read(&buf[0], buf.size()) || f.gcount() > 0)
+            result.append(&buf[0], static_cast<size_t>(f.gcount()));
+        TEST(result == content);
+    }
+    {
+        // Default window covers the whole file
+        nw::mapped_ifstream f(filepath);
+        std::vector<char> buf(content.size() + 1);
+        f.read(&buf[0], buf.size());
+        TEST(static_cast<size_t>(f.gcount()) == content.size());
+        TEST(std::string(&buf[0], content.size()) == content);
+    }
+    nw::remove(filepath);
+}
+
+void test_seek(const char *filepath)
+{
+    std::cout << "Seeks" << std::endl;
+    size_t const window = nw::details::mapped_file::granularity();
+    std::string const content = make_content(window * 4 + 17);
+    write_file(filepath, content);
+    nw::mapped_ifstream f;
+    f.rdbuf()->window_size(window * 2);
+    f.open(filepath);
+    TEST(f);
+    size_t const positions[] = {0, 1, window - 1, window, window + 1, 3 * window + 5, 2 * window, 5, content.size() - 1};
+    for(size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); i++)
+    {
+        size_t const pos = positions[i];
+        TEST(f.seekg(pos));
+        TEST(f.tellg() == std::streampos(pos));
+        TEST(f.get() == static_cast<unsigned char>(content[pos]));
+        TEST(f.tellg() == std::streampos(pos + 1));
+        // Relative seek back to the same char
+        TEST(f.seekg(-1, std::ios::cur));
+        TEST(f.get() == static_cast<unsigned char>(content[pos]));
+        if(pos + 10 < content.size())
+        {
+            TEST(f.seekg(9, std::ios::cur));
+            TEST(f.get() == static_cast<unsigned char>(content[pos + 10]));
+        }
+    }
+    TEST(f.seekg(-3, std::ios::end));
+    TEST(f.tellg() == std::streampos(content.size() - 3));
+    TEST(f.get() == static_cast<unsigned char>(content[content.size() - 3]));
+    // Negative positions are invalid
+    TEST(!f.seekg(-1, std::ios::beg));
+    f.clear();
+    // Seeking past the end is allowed but reading fails
+    TEST(f.seekg(content.size() + 10));
+    TEST(f.tellg() == std::streampos(content.size() + 10));
+    TEST(f.get() == EOF);
+    f.clear();
+    // Putback across the start of a window
+    TEST(f.seekg(window * 2));
+    TEST(f.get() == static_cast<unsigned char>(content[window * 2]));
+    TEST(f.seekg(window * 2));
+    TEST(f.unget());
+    TEST(f.tellg() == std::streampos(window * 2 - 1));
+    TEST(f.get() == static_cast<unsigned char>(content[window * 2 - 1]));
+    TEST(f.putback(content[window * 2 - 1]));
+    // Putting back a different char is not possible as the mapping is read-only
+    TEST(!f.putback('\n'));
+    nw::remove(filepath);
+}
+
+int main(int, char **argv)
+{
+    const std::string exampleFilename = std::string(argv[0]) + "-\xd7\xa9-\xd0\xbc-\xce\xbd.txt";
+    try
+    {
+        test_open_close(exampleFilename.c_str());
+        test_sequential(exampleFilename.c_str());
+        test_seek(exampleFilename.c_str());
+    } catch(std::exception const &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Ok" << std::endl;
+    return 0;
+}
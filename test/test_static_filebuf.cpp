@@ -0,0 +1,158 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#include <boost/nowide/filebuf.hpp>
+#include <boost/nowide/cstdio.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+#include <utility>
+#include "test.hpp"
+
+// Count all allocations done through operator new
+static size_t allocations = 0;
+
+void *operator new(size_t n)
+{
+    allocations++;
+    if(void *p = std::malloc(n ? n : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void *p) throw()
+{
+    std::free(p);
+}
+#ifdef __cpp_sized_deallocation
+void operator delete(void *p, size_t) throw()
+{
+    std::free(p);
+}
+#endif
+
+#if BOOST_NOWIDE_USE_WIN_FSTREAM
+namespace nw = boost::nowide;
+
+void test_static_filebuf(const char *filepath)
+{
+    std::cout << "Read/Write" << std::endl;
+    nw::static_filebuf<64> buf;
+    TEST(buf.static_buffer_size() == 64u);
+    TEST(buf.buffer_size() == 64u);
+    std::iostream stream(&buf);
+    char content[200];
+    for(size_t i = 0; i < sizeof(content); i++)
+        content[i] = static_cast<char>('a' + i % 26);
+
+    size_t const start = allocations;
+    TEST(buf.open(filepath, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary));
+    TEST(stream.write(content, 10));
+    TEST(stream.write(content + 10, sizeof(content) - 10));
+    TEST(stream.seekg(0));
+    char read[sizeof(content)];
+    TEST(stream.read(read, sizeof(read)));
+    TEST(std::memcmp(read, content, sizeof(content)) == 0);
+    TEST(stream.seekp(100));
+    TEST(stream.put('X'));
+    TEST(stream.seekg(99));
+    TEST(stream.get() == content[99]);
+    TEST(stream.get() == 'X');
+    TEST(buf.close());
+    TEST(allocations == start);
+    // The embedded buffer is kept for the next file
+    TEST(buf.buffer_size() == 64u);
+
+    std::cout << "Destruction flushes" << std::endl;
+    {
+        nw::static_filebuf<16> buf2;
+        TEST(buf2.open(filepath, std::ios::out | std::ios::trunc | std::ios::binary));
+        TEST(buf2.sputn("Hello", 5) == 5);
+    }
+    nw::static_filebuf<16> buf3;
+    TEST(buf3.open(filepath, std::ios::in | std::ios::binary));
+    TEST(buf3.sgetn(read, sizeof(read)) == 5);
+    TEST(std::string(read, 5) == "Hello");
+    buf3.close();
+    TEST(nw::remove(filepath) == 0);
+}
+
+void test_swap(const char *filepath, const char *filepath2)
+{
+    std::cout << "Swap" << std::endl;
+    nw::filebuf heap_buf;
+    TEST(heap_buf.open(filepath2, std::ios::out | std::ios::trunc | std::ios::binary));
+    TEST(heap_buf.sputn("Heap", 4) == 4);
+    {
+        nw::static_filebuf<64> buf;
+        TEST(buf.open(filepath, std::ios::out | std::ios::trunc | std::ios::binary));
+        TEST(buf.sputn("Hello", 5) == 5);
+        // Via the base class, only the files are exchanged
+        nw::swap(heap_buf, static_cast<nw::filebuf &>(buf));
+        TEST(buf.buffer_size() == 64u);
+        TEST(buf.sputn(" Static", 7) == 7);
+        nw::static_filebuf<64> buf2;
+        nw::swap(buf, buf2);
+        TEST(!buf.is_open());
+        TEST(buf2.sputn("!", 1) == 1);
+    }
+    // The buffer of the destroyed static_filebuf is not used
+    TEST(heap_buf.sputn(" World", 6) == 6);
+    TEST(heap_buf.close());
+    nw::static_filebuf<16> buf;
+    char read[20];
+    TEST(buf.open(filepath, std::ios::in | std::ios::binary));
+    TEST(buf.sgetn(read, sizeof(read)) == 11);
+    TEST(std::string(read, 11) == "Hello World");
+    buf.close();
+    TEST(buf.open(filepath2, std::ios::in | std::ios::binary));
+    TEST(buf.sgetn(read, sizeof(read)) == 12);
+    TEST(std::string(read, 12) == "Heap Static!");
+    buf.close();
+#ifndef BOOST_NO_CXX11_RVALUE_REFERENCES
+    {
+        // Moving out of a static_filebuf leaves its buffer behind
+        nw::static_filebuf<64> src;
+        TEST(src.open(filepath, std::ios::out | std::ios::app | std::ios::binary));
+        TEST(src.sputn("!", 1) == 1);
+        nw::filebuf moved(std::move(static_cast<nw::filebuf &>(src)));
+        TEST(!src.is_open());
+        TEST(src.buffer_size() == 64u);
+        TEST(moved.is_open());
+        TEST(moved.sputn("?", 1) == 1);
+    }
+    TEST(buf.open(filepath, std::ios::in | std::ios::binary));
+    TEST(buf.sgetn(read, sizeof(read)) == 13);
+    TEST(std::string(read, 13) == "Hello World!?");
+    buf.close();
+#endif
+    TEST(nw::remove(filepath) == 0);
+    TEST(nw::remove(filepath2) == 0);
+}
+#endif
+
+int main(int, char **argv)
+{
+    const std::string exampleFilename = std::string(argv[0]) + "-\xd7\xa9-\xd0\xbc-\xce\xbd.txt";
+    try
+    {
+#if BOOST_NOWIDE_USE_WIN_FSTREAM
+        test_static_filebuf(exampleFilename.c_str());
+        test_swap(exampleFilename.c_str(), (exampleFilename + "2").c_str());
+#else
+        std::cout << "Skipped, requires BOOST_NOWIDE_USE_WIN_FSTREAM" << std::endl;
+#endif
+    } catch(std::exception const &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,217 @@
+//
+//  Copyright (c) 2019 Alexander Grund
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <boost/nowide/utf16_codecvt.hpp>
+#include <boost/nowide/cstdio.hpp>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <locale>
+#include <string>
+#include <vector>
+#include "test.hpp"
+
+static wchar_t const *wide_name = L"\U0001D49E-\u043F\u0440\u0438\u0432\u0435\u0442-\u3084\u3042.txt 0123456789 abcdefghijklmnop";
+
+// Encode the wide test string to UTF-16 bytes
+std::string to_utf16_bytes(std::wstring const &s, bool little_endian)
+{
+    std::string res;
+    for(size_t i = 0; i < s.size(); i++)
+    {
+        unsigned long c = static_cast<unsigned long>(s[i]);
+        unsigned units[2] = {static_cast<unsigned>(c), 0};
+        int n = 1;
+        if(c > 0xFFFF)
+        {
+            c -= 0x10000;
+            units[0] = 0xD800 + (c >> 10);
+            units[1] = 0xDC00 + (c & 0x3FF);
+            n = 2;
+        }
+        for(int j = 0; j < n; j++)
+        {
+            char const lo = static_cast<char>(units[j] & 0xFF);
+            char const hi = static_cast<char>(units[j] >> 8);
+            res += little_endian ? lo : hi;
+            res += little_endian ? hi : lo;
+        }
+    }
+    return res;
+}
+
+template<typename CharType>
+std::basic_string<CharType> to_internal(std::wstring const &s)
+{
+    std::basic_string<CharType> res;
+    for(size_t i = 0; i < s.size(); i++)
+    {
+        unsigned long c = static_cast<unsigned long>(s[i]);
+        if(sizeof(CharType) == 2 && c > 0xFFFF)
+        {
+            c -= 0x10000;
+            res += static_cast<CharType>(0xD800 + (c >> 10));
+            res += static_cast<CharType>(0xDC00 + (c & 0x3FF));
+        } else
+            res += static_cast<CharType>(c);
+    }
+    return res;
+}
+
+template<typename CharType, boost::nowide::utf16_byte_order ByteOrder>
+void test_conversions()
+{
+    typedef std::codecvt<CharType, char, std::mbstate_t> cvt_type;
+    std::locale l(std::locale::classic(), new boost::nowide::utf16_codecvt<CharType, ByteOrder>());
+    cvt_type const &cvt = std::use_facet<cvt_type>(l);
+
+    std::string const bytes = to_utf16_bytes(wide_name, ByteOrder == boost::nowide::utf16_le);
+    std::basic_string<CharType> const chars = to_internal<CharType>(wide_name);
+
+    // Input in chunks of n bytes into output chunks of m chars
+    for(size_t n = 1; n <= 9; n++)
+    {
+        for(size_t m = 1; m <= 5; m++)
+        {
+            std::mbstate_t mb = std::mbstate_t();
+            char const *from = bytes.c_str();
+            char const *const real_end = from + bytes.size();
+            char const *end = from;
+            std::basic_string<CharType> res;
+            while(from != real_end)
+            {
+                end = std::min(end + n, real_end);
+                CharType buf[8];
+                CharType *to_next;
+                char const *from_next;
+                std::mbstate_t mb2 = mb;
+                std::codecvt_base::result r = cvt.in(mb, from, end, from_next, buf, buf + m, to_next);
+                TEST(r == cvt_type::ok || r == cvt_type::partial);
+#ifndef BOOST_NOWIDE_DO_LENGTH_MBSTATE_CONST
+                TEST(cvt.length(mb2, from, end, m) == from_next - from);
+                TEST(std::memcmp(&mb, &mb2, sizeof(mb)) == 0);
+#endif
+                res.append(buf, to_next);
+                from = from_next;
+            }
+            TEST(res == chars);
+        }
+    }
+    // Output in chunks of n chars into output chunks of m bytes
+    for(size_t n = 1; n <= 5; n++)
+    {
+        for(size_t m = 4; m <= 9; m++)
+        {
+            std::mbstate_t mb = std::mbstate_t();
+            CharType const *from = chars.c_str();
+            CharType const *const real_end = from + chars.size();
+            std::string res;
+            while(from != real_end)
+            {
+                CharType const *end = std::min(from + n, real_end);
+                char buf[16];
+                char *to_next;
+                std::codecvt_base::result r = cvt.out(mb, from, end, from, buf, buf + m, to_next);
+                TEST(r == cvt_type::ok || r == cvt_type::partial);
+                res.append(buf, to_next);
+            }
+            char *to_next;
+            char buf[4];
+            TEST(cvt.unshift(mb, buf, buf + 4, to_next) == cvt_type::ok);
+            TEST(res == bytes);
+        }
+    }
+
+    // Unpaired surrogates are replaced
+    {
+        std::wstring input;
+        input += static_cast<wchar_t>('a');
+        input += static_cast<wchar_t>(0xDC00);
+        input += static_cast<wchar_t>('b');
+        std::string in_bytes = to_utf16_bytes(input, ByteOrder == boost::nowide::utf16_le);
+        // Append a high surrogate followed by a non-surrogate
+        std::string const high_and_c = to_utf16_bytes(std::wstring(1, static_cast<wchar_t>(0xD800)) + L"c", true);
+        std::string const high_and_c_be = to_utf16_bytes(std::wstring(1, static_cast<wchar_t>(0xD800)) + L"c", false);
+        in_bytes += (ByteOrder == boost::nowide::utf16_le) ? high_and_c : high_and_c_be;
+        std::mbstate_t mb = std::mbstate_t();
+        CharType buf[8];
+        CharType *to_next;
+        char const *from_next;
+        TEST(cvt.in(mb, in_bytes.c_str(), in_bytes.c_str() + in_bytes.size(), from_next, buf, buf + 8, to_next) == cvt_type::ok);
+        std::basic_string<CharType> const expected = to_internal<CharType>(L"a\uFFFDb\uFFFDc");
+        TEST(std::basic_string<CharType>(buf, to_next) == expected);
+    }
+    // Incomplete input
+    {
+        std::mbstate_t mb = std::mbstate_t();
+        std::string const in_bytes = to_utf16_bytes(L"\U0001D49E", ByteOrder == boost::nowide::utf16_le);
+        CharType buf[8];
+        CharType *to_next;
+        char const *from_next;
+        TEST(cvt.in(mb, in_bytes.c_str(), in_bytes.c_str() + 3, from_next, buf, buf + 8, to_next) == cvt_type::partial);
+        TEST(from_next == in_bytes.c_str());
+        TEST(to_next == buf);
+        TEST(cvt.in(mb, in_bytes.c_str(), in_bytes.c_str() + 1, from_next, buf, buf + 8, to_next) == cvt_type::partial);
+        TEST(from_next == in_bytes.c_str());
+    }
+}
+
+void test_wide_stream(std::string const &filename)
+{
+    std::cout << "Reading a UTF-16LE file with std::wifstream" << std::endl;
+    std::string const bytes = to_utf16_bytes(wide_name, true);
+    {
+        std::ofstream f(filename.c_str(), std::ios::binary);
+        for(int i = 0; i < 1000; i++)
+            f.write(bytes.c_str(), bytes.size());
+    }
+    std::locale l(std::locale::classic(), new boost::nowide::utf16_codecvt<wchar_t>());
+    {
+        std::wifstream f;
+        f.imbue(l);
+        f.open(filename.c_str(), std::ios::binary);
+        TEST(f);
+        std::wstring const expected = to_internal<wchar_t>(wide_name);
+        std::vector<wchar_t> buf(expected.size());
+        for(int i = 0; i < 1000; i++)
+        {
+            TEST(f.read(&buf[0], buf.size()));
+            TEST(std::wstring(buf.begin(), buf.end()) == expected);
+        }
+        TEST(f.get() == std::char_traits<wchar_t>::eof());
+    }
+    boost::nowide::remove(filename.c_str());
+}
+
+int main(int, char **argv)
+{
+    try
+    {
+        std::cout << "wchar_t LE/BE" << std::endl;
+        test_conversions<wchar_t, boost::nowide::utf16_le>();
+        test_conversions<wchar_t, boost::nowide::utf16_be>();
+#ifndef BOOST_NO_CXX11_CHAR16_T
+        std::cout << "char16_t LE/BE" << std::endl;
+        test_conversions<char16_t, boost::nowide::utf16_le>();
+        test_conversions<char16_t, boost::nowide::utf16_be>();
+#endif
+#ifndef BOOST_NO_CXX11_CHAR32_T
+        std::cout << "char32_t LE/BE" << std::endl;
+        test_conversions<char32_t, boost::nowide::utf16_le>();
+        test_conversions<char32_t, boost::nowide::utf16_be>();
+#endif
+        test_wide_stream(std::string(argv[0]) + "-utf16.txt");
+    } catch(std::exception const &e)
+    {
+        std::cerr << "Failed : " << e.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Ok" << std::endl;
+    return 0;
+}
+///
+// vim: tabstop=4 expandtab shiftwidth=4 softtabstop=4